@@ -1,4 +1,6 @@
 #include "app_controller.h"
+#include <QFileInfo>
+#include <algorithm> // For std::min, std::max
 
 AppController::AppController(QWebEngineView* mapView, GraphManager* graphManager, RouteFinder* routeFinder, QObject *parent)
     : QObject(parent),
@@ -13,28 +15,94 @@ AppController::AppController(QWebEngineView* mapView, GraphManager* graphManager
     if (mapInterface) {
         connect(mapInterface, &MapInterface::mapReady, this, &AppController::handleMapReady);
         connect(mapInterface, &MapInterface::nodeSelectionRequested, this, &AppController::handleNodeSelectionRequested);
-        connect(mapInterface, &MapInterface::obstacleMarkerDrawn, this, &AppController::handleObstacleMarkerDrawn);
-        connect(mapInterface, &MapInterface::obstacleAreaDrawn, this, &AppController::handleObstacleAreaDrawn);
+        connect(mapInterface, &MapInterface::obstacleShapeChanged, this, &AppController::handleObstacleShapeChanged);
+        connect(mapInterface, &MapInterface::obstacleShapeDeleted, this, &AppController::handleObstacleShapeDeleted);
+        connect(mapInterface, &MapInterface::viewportChanged, this, &AppController::handleViewportChanged);
     } else {
         qCritical() << "AppController: MapInterface object not found via QWebChannel.";
     }
 
-    // Connect graph manager updates to map display updates
-    connect(graphManager_, &GraphManager::graphUpdated, this, &AppController::updateMapJsDisplay);
+    // Connect graph manager updates to map display updates (and route invalidation)
+    connect(graphManager_, &GraphManager::graphUpdated, this, &AppController::handleGraphUpdated);
+    // Landmark tables depend on obstacles, so they are refreshed in the background while ALT is selected
+    connect(graphManager_, &GraphManager::graphUpdated, this, [this]() {
+        if (routingAlgorithm_ == RoutingAlgorithm::ALT && !loading_) scheduleLandmarkRebuild();
+    });
 }
 
 void AppController::loadGraphData(const QString& filePath) {
     emit statusMessage("Loading graph data...");
+    loading_ = true; // Until finishLoading(): the graph is rebuilt step by step on the worker
     // Run graph loading and triangulation in a separate thread using QtConcurrent
     // This prevents the UI from freezing during heavy computation
     QtConcurrent::run([=]() {
-        if (graphManager_->loadNodesFromFile(filePath.toStdString())) {
-            graphManager_->performTriangulation();
-            emit statusMessage("Graph loaded and triangulated successfully. "
+        // Queued behind the graphUpdated signals of the load, which are ignored while loading_ is set
+        auto graphReady = [this]() {
+            QMetaObject::invokeMethod(this, [this]() { finishLoading(); }, Qt::QueuedConnection);
+        };
+        // A snapshot next to the input file, at least as new as it, skips parsing and triangulation
+        const QString snapshotPath = filePath + ".snapshot";
+        QFileInfo inputInfo(filePath);
+        QFileInfo snapshotInfo(snapshotPath);
+        const bool snapshotUsable = snapshotInfo.exists() && snapshotInfo.lastModified() >= inputInfo.lastModified();
+        fitMapAfterVersion_ = graphManager_->getGraphVersion();
+        fitMapToGraph_ = true;
+        if (snapshotUsable && graphManager_->loadSnapshot(snapshotPath.toStdString())) {
+            graphReady();
+            // Ready right away: the hierarchy is built afterwards, and until it is in place
+            // Contraction Hierarchies queries fall back to A*
+            const QString loadedMessage = "Graph loaded from snapshot. "
+                                          "Total nodes: " + QString::number(graphManager_->getAllNodes().size()) +
+                                          ", Total edges: " + QString::number(graphManager_->getEdgeCount());
+            emit statusMessage(loadedMessage + ". Building contraction hierarchy in the background...");
+            routeFinder_->buildContractionHierarchy(*graphManager_);
+            emit statusMessage(loadedMessage + ". Contraction hierarchy ready.");
+            return;
+        }
+
+        // OpenStreetMap extracts bring their own street edges; CSV nodes are triangulated.
+        const bool isOsm = filePath.endsWith(".osm", Qt::CaseInsensitive) || filePath.endsWith(".pbf", Qt::CaseInsensitive);
+        bool loaded = false;
+        if (isOsm) {
+            emit statusMessage("Importing OpenStreetMap streets...");
+            loaded = graphManager_->loadOsmFile(filePath.toStdString());
+        } else {
+            // CSV nodes are streamed: every parsed batch is previewed on the map right away
+            size_t nodesRead = 0;
+            bool firstBatch = true;
+            loaded = graphManager_->loadNodesFromFile(filePath.toStdString(),
+                [&](const std::vector<Node>& batch, size_t bytesDone, size_t bytesTotal) {
+                    nodesRead += batch.size();
+                    publishLoadPreview(batch, firstBatch);
+                    firstBatch = false;
+                    emit statusMessage("Loading nodes... " + QString::number(bytesTotal ? 100 * bytesDone / bytesTotal : 100) +
+                                       "% (" + QString::number(nodesRead) + " nodes)");
+                });
+        }
+        if (loaded) {
+            if (!isOsm) {
+                emit statusMessage("Triangulating " + QString::number(graphManager_->getAllNodes().size()) + " nodes...");
+                graphManager_->performTriangulation();
+            }
+            graphReady(); // Saving the snapshot and the hierarchy only read the graph
+            // Low-memory mode keeps only rounded weights, which must not be baked into a snapshot
+            if (!graphManager_->isLowMemoryMode() && !graphManager_->saveSnapshot(snapshotPath.toStdString())) {
+                qWarning() << "AppController: Could not save graph snapshot" << snapshotPath;
+            }
+            emit statusMessage("Building contraction hierarchy...");
+            routeFinder_->buildContractionHierarchy(*graphManager_);
+            QString skipped;
+            if (graphManager_->getLoadErrorCount() > 0) {
+                skipped = ". Skipped " + QString::number(graphManager_->getLoadErrorCount()) + " malformed rows (" +
+                          QString::fromStdString(graphManager_->getLoadErrors().front()) + ")";
+            }
+            emit statusMessage(QString(isOsm ? "Street graph imported successfully. " : "Graph loaded and triangulated successfully. ") +
                                "Total nodes: " + QString::number(graphManager_->getAllNodes().size()) +
-                               ", Total edges: " + QString::number(graphManager_->getAllEdges().size()));
+                               ", Total edges: " + QString::number(graphManager_->getEdgeCount()) + skipped);
             // The graphUpdated signal from GraphManager will trigger updateMapJsDisplay()
         } else {
+            fitMapToGraph_ = false;
+            graphReady(); // Shows whatever the failed load left behind
             emit statusMessage("Failed to load graph data.");
         }
     });
@@ -47,23 +115,134 @@ void AppController::findRoute() {
         return;
     }
 
+    if (routeMatchesInputs(currentRoute_)) {
+        // Endpoints and obstacles are unchanged since the last search, so its result still holds
+        emit statusMessage(currentRoute_.path.empty() ? "No route found between selected nodes." : "Route found!");
+        emit routeFound(!currentRoute_.path.empty());
+        return;
+    }
+
     emit statusMessage("Finding route...");
+    routeRequested_ = true;
+    requestRouteUpdate();
+}
+
+bool AppController::routeMatchesInputs(const RouteState& state) const {
+    return state.valid &&
+           state.originNodeId == originNodeId_ &&
+           state.destinationNodeId == destinationNodeId_ &&
+           state.graphVersion == graphManager_->getGraphVersion();
+}
+
+void AppController::requestRouteUpdate() {
+    if (originNodeId_ == -1 || destinationNodeId_ == -1) {
+        currentRoute_ = RouteState();
+        return;
+    }
+    if (routeMatchesInputs(currentRoute_) || routeMatchesInputs(pendingRoute_)) {
+        return; // Up to date, or the search for exactly these inputs is already running
+    }
+
+    RouteState request;
+    request.originNodeId = originNodeId_;
+    request.destinationNodeId = destinationNodeId_;
+    request.graphVersion = graphManager_->getGraphVersion();
+    request.valid = true;
+    pendingRoute_ = request;
+
+    RoutingAlgorithm algorithm = routingAlgorithm_;
+    QtConcurrent::run([this, request, algorithm]() {
+        RouteState result = request;
+        result.path = routeFinder_->findRoute(*graphManager_, request.originNodeId, request.destinationNodeId, algorithm);
+        // Hand the result back to the UI thread, which owns the route state and the map view
+        QMetaObject::invokeMethod(this, [this, result]() { handleRouteComputed(result); }, Qt::QueuedConnection);
+    });
+}
+
+void AppController::handleRouteComputed(const RouteState& result) {
+    if (pendingRoute_.valid &&
+        pendingRoute_.originNodeId == result.originNodeId &&
+        pendingRoute_.destinationNodeId == result.destinationNodeId &&
+        pendingRoute_.graphVersion == result.graphVersion) {
+        pendingRoute_ = RouteState();
+    }
+    if (!routeMatchesInputs(result)) {
+        // Endpoints or obstacles changed while searching; the newer request replaces this result
+        requestRouteUpdate();
+        return;
+    }
+
+    currentRoute_ = result;
+    if (routeRequested_) {
+        routeRequested_ = false;
+        emit statusMessage(result.path.empty() ? "No route found between selected nodes." : "Route found!");
+        emit routeFound(!result.path.empty());
+    }
+    updateMapJsDisplay();
+}
+
+void AppController::handleGraphUpdated() {
+    if (loading_) {
+        return; // finishLoading() redraws once the load is done
+    }
+    updateMapJsDisplay();
+    requestRouteUpdate(); // No-op unless obstacles or the graph itself changed the version
+}
+
+void AppController::finishLoading() {
+    loading_ = false;
+    handleGraphUpdated();
+    if (routingAlgorithm_ == RoutingAlgorithm::ALT) {
+        scheduleLandmarkRebuild();
+    }
+}
+
+void AppController::setRoutingAlgorithm(RoutingAlgorithm algorithm) {
+    routingAlgorithm_ = algorithm;
+    switch (algorithm) {
+        case RoutingAlgorithm::BidirectionalAStar:
+            emit statusMessage("Routing algorithm: Bidirectional A*.");
+            break;
+        case RoutingAlgorithm::ContractionHierarchies:
+            emit statusMessage("Routing algorithm: Contraction Hierarchies.");
+            break;
+        case RoutingAlgorithm::ALT:
+            emit statusMessage("Routing algorithm: A* with landmarks (ALT).");
+            scheduleLandmarkRebuild(); // Landmarks are not kept up to date under the other algorithms
+            break;
+        case RoutingAlgorithm::Incremental:
+            emit statusMessage("Routing algorithm: Incremental (LPA*).");
+            break;
+        case RoutingAlgorithm::AStar:
+        default:
+            emit statusMessage("Routing algorithm: A*.");
+            break;
+    }
+}
+
+void AppController::setLowMemoryMode(bool enabled) {
+    emit statusMessage(enabled ? "Compressing adjacency..." : "Decoding adjacency...");
     QtConcurrent::run([=]() {
-        std::vector<int> path = routeFinder_->findRoute(*graphManager_, originNodeId_, destinationNodeId_);
-        if (!path.empty()) {
-            emit statusMessage("Route found!");
-            // Update the map display with the new route
-            // This is done via updateMapJsDisplay which will serialize current state
-        } else {
-            emit statusMessage("No route found between selected nodes.");
+        graphManager_->setLowMemoryMode(enabled);
+        // The hierarchy needs the CSR arrays: rebuilding drops it (and the arrays it holds) in low-memory mode
+        routeFinder_->buildContractionHierarchy(*graphManager_);
+        emit lowMemoryModeApplied(enabled);
+        if (!enabled) {
+            emit statusMessage("Low-memory adjacency off.");
+            return;
+        }
+        QString size;
+        if (auto compressed = graphManager_->getCompressedAdjacency()) {
+            size = " (" + QString::number(compressed->memoryBytes() / (1024 * 1024)) + " MiB)";
         }
-        updateMapJsDisplay(); // Force update after route search
-        emit routeFound(!path.empty());
+        emit statusMessage("Low-memory adjacency on" + size + ". Routing uses A* or bidirectional A*.");
     });
 }
 
 void AppController::clearObstacles() {
     graphManager_->clearAllObstacles();
+    // Every shape drawn so far was handled before this call, so none is pending anymore
+    mapView_->page()->runJavaScript("clearPendingObstacleShapes();");
     emit statusMessage("All obstacles cleared.");
     // graphUpdated signal from GraphManager will trigger updateMapJsDisplay()
 }
@@ -85,10 +264,12 @@ void AppController::handleNodeSelectionRequested(int nodeId) {
         case RouteSelectionMode::Origin:
             originNodeId_ = nodeId;
             emit statusMessage("Origin node selected: " + QString::number(nodeId));
+            updateMapJsDisplay(); // Redraw map to show the highlight
             break;
         case RouteSelectionMode::Destination:
             destinationNodeId_ = nodeId;
             emit statusMessage("Destination node selected: " + QString::number(nodeId));
+            updateMapJsDisplay();
             break;
         case RouteSelectionMode::Obstacle:
             graphManager_->toggleObstacleNode(nodeId);
@@ -103,44 +284,179 @@ void AppController::handleNodeSelectionRequested(int nodeId) {
             emit statusMessage("No selection mode active. Click a UI button first.");
             break;
     }
-    updateMapJsDisplay(); // Redraw map to show highlights/obstacles
+    // Only searches if the endpoints changed; obstacle toggles already redrew and rerouted
+    // through graphUpdated
+    requestRouteUpdate();
 }
 
-void AppController::handleObstacleMarkerDrawn(const LatLon& coords) {
-    int closestNodeId = graphManager_->getClosestNodeId(coords.lat, coords.lon);
-    if (closestNodeId != -1) {
-        graphManager_->toggleObstacleNode(closestNodeId); // Mark closest node as obstacle
-        emit statusMessage("Obstacle added at node: " + QString::number(closestNodeId));
-    } else {
-        emit statusMessage("No nearby node found for obstacle marker.");
+bool AppController::parseObstacleShape(const QString& geoJson, ObstacleShape& shape) const {
+    nlohmann::json feature = nlohmann::json::parse(geoJson.toStdString(), nullptr, false);
+    if (feature.is_discarded() || !feature.is_object()) {
+        qWarning() << "AppController: Could not parse obstacle GeoJSON.";
+        return false;
     }
-    updateMapJsDisplay();
+    const nlohmann::json& geometry = feature.contains("geometry") ? feature["geometry"] : feature;
+    std::string type = geometry.value("type", "");
+
+    try {
+        if (type == "Polygon") {
+            // GeoJSON positions are [lon, lat]
+            shape.type = ObstacleShape::Type::Polygon;
+            shape.rings.clear();
+            for (const auto& ring : geometry.at("coordinates")) {
+                std::vector<LatLon> vertices;
+                for (const auto& position : ring) {
+                    vertices.emplace_back(position.at(1).get<double>(), position.at(0).get<double>());
+                }
+                shape.rings.push_back(std::move(vertices));
+            }
+            return true;
+        }
+        if (type == "Point") {
+            const auto& position = geometry.at("coordinates");
+            shape.center = LatLon(position.at(1).get<double>(), position.at(0).get<double>());
+            if (feature.contains("properties") && feature["properties"].is_object() &&
+                feature["properties"].contains("radius")) {
+                shape.type = ObstacleShape::Type::Circle;
+                shape.radius_km = feature["properties"]["radius"].get<double>() / 1000.0;
+            } else {
+                shape.type = ObstacleShape::Type::Point; // Marker: blocks the closest node
+            }
+            return true;
+        }
+    } catch (const nlohmann::json::exception& e) {
+        qWarning() << "AppController: Malformed obstacle GeoJSON:" << e.what();
+        return false;
+    }
+    qWarning() << "AppController: Unsupported obstacle geometry type" << QString::fromStdString(type);
+    return false;
 }
 
-void AppController::handleObstacleAreaDrawn(double minLat, double minLon, double maxLat, double maxLon) {
-    // The order of lat/lon from Leaflet.Draw bounds can be a bit tricky,
-    // ensure min/max are correct for your GraphManager's expectation.
-    graphManager_->setObstacleArea(minLat, minLon, maxLat, maxLon);
-    emit statusMessage("Obstacle area set. Nodes within area marked.");
+void AppController::handleObstacleShapeChanged(int shapeId, const QString& geoJson) {
+    ObstacleShape shape;
+    if (!parseObstacleShape(geoJson, shape)) {
+        emit statusMessage("Unsupported obstacle shape.");
+        // The map keeps a just-drawn shape until C++ lists it, so a new one is removed explicitly
+        std::vector<int> known = graphManager_->getObstacleShapeIds();
+        if (std::find(known.begin(), known.end(), shapeId) == known.end()) {
+            mapView_->page()->runJavaScript(QString("rejectObstacleShape(%1);").arg(shapeId));
+        }
+        return;
+    }
+    int count = graphManager_->setObstacleShape(shapeId, shape);
+    emit statusMessage("Obstacle area set. " + QString::number(count) + " nodes inside the shape marked.");
+    // graphUpdated signal from GraphManager will trigger updateMapJsDisplay()
+}
+
+void AppController::handleObstacleShapeDeleted(int shapeId) {
+    if (graphManager_->removeObstacleShape(shapeId)) {
+        emit statusMessage("Obstacle area removed.");
+    }
+}
+
+void AppController::handleViewportChanged(double minLat, double minLon, double maxLat, double maxLon) {
+    viewport_ = { minLat, minLon, maxLat, maxLon, true };
     updateMapJsDisplay();
 }
 
+void AppController::scheduleLandmarkRebuild() {
+    {
+        std::lock_guard<std::mutex> lock(landmarkRebuildMutex_);
+        landmarkRebuildPending_ = true;
+        if (landmarkRebuildRunning_) {
+            return; // The running worker picks up the pending request when it finishes
+        }
+        landmarkRebuildRunning_ = true;
+    }
+    QtConcurrent::run([this]() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(landmarkRebuildMutex_);
+                if (!landmarkRebuildPending_) {
+                    landmarkRebuildRunning_ = false;
+                    return;
+                }
+                landmarkRebuildPending_ = false;
+            }
+            routeFinder_->rebuildLandmarks(*graphManager_);
+        }
+    });
+}
+
+void AppController::publishLoadPreview(const std::vector<Node>& batch, bool fitMap) {
+    if (batch.empty()) return;
+    // A uniform sample keeps every message small enough to draw at once
+    const size_t stride = batch.size() / kMaxPreviewNodesPerBatch + 1;
+    std::vector<double> points; // Flat lat, lon pairs
+    points.reserve(2 * (batch.size() / stride + 1));
+    double minLat = batch[0].coords.lat, maxLat = minLat;
+    double minLon = batch[0].coords.lon, maxLon = minLon;
+    for (size_t i = 0; i < batch.size(); i += stride) {
+        const LatLon& c = batch[i].coords;
+        points.push_back(c.lat);
+        points.push_back(c.lon);
+        minLat = std::min(minLat, c.lat);
+        maxLat = std::max(maxLat, c.lat);
+        minLon = std::min(minLon, c.lon);
+        maxLon = std::max(maxLon, c.lon);
+    }
+    nlohmann::json preview;
+    preview["points"] = points;
+    if (fitMap) {
+        preview["fitBounds"] = { minLat, minLon, maxLat, maxLon };
+    }
+    QString jsCommand = QString("appendLoadPreview(%1);").arg(QString::fromStdString(preview.dump()));
+    // Called on the loading thread; the view belongs to the UI thread
+    QMetaObject::invokeMethod(this, [this, jsCommand]() { mapView_->page()->runJavaScript(jsCommand); },
+                              Qt::QueuedConnection);
+}
+
 // Helper to push current graph state to JS for display
 void AppController::updateMapJsDisplay() {
+    if (loading_) {
+        return; // The load preview owns the map until the graph is complete
+    }
     nlohmann::json jsonData;
+    const auto& nodes = graphManager_->getAllNodes();
+    const PackedRTree::Box graphBounds = graphManager_->getGraphBounds();
+
+    // A new graph is shown by zooming to it first; the map then reports the new viewport
+    if (fitMapToGraph_ && graphManager_->getGraphVersion() > fitMapAfterVersion_ &&
+        fitMapToGraph_.exchange(false) && !nodes.empty()) {
+        jsonData["fitBounds"] = { graphBounds.min_lat, graphBounds.min_lon, graphBounds.max_lat, graphBounds.max_lon };
+    }
+
+    // Only the graph inside the viewport is sent, decimated when it holds too many nodes
+    ViewportGraph view = viewport_.known
+        ? graphManager_->getViewportGraph(viewport_.minLat, viewport_.minLon, viewport_.maxLat, viewport_.maxLon, kMaxViewportNodes)
+        : graphManager_->getViewportGraph(graphBounds.min_lat, graphBounds.min_lon, graphBounds.max_lat, graphBounds.max_lon, kMaxViewportNodes);
+    // Origin and destination stay clickable even if decimation merged them away
+    for (int nodeId : { originNodeId_, destinationNodeId_ }) {
+        int index = graphManager_->getNodeIndex(nodeId);
+        if (index >= 0 && std::find(view.node_indices.begin(), view.node_indices.end(), index) == view.node_indices.end()) {
+            view.node_indices.push_back(index);
+        }
+    }
+
+    const ObstacleBitset& obstacles = graphManager_->getObstacles();
     jsonData["nodes"] = nlohmann::json::array();
-    for (const auto& node : graphManager_->getAllNodes()) {
+    jsonData["obstacleNodeIds"] = nlohmann::json::array(); // Visible blocked nodes, for JS to highlight
+    for (int index : view.node_indices) {
+        const Node& node = nodes[index];
         jsonData["nodes"].push_back({
             {"id", node.id},
             {"lat", node.coords.lat},
             {"lon", node.coords.lon}
         });
+        if (obstacles.test(index)) {
+            jsonData["obstacleNodeIds"].push_back(node.id);
+        }
     }
 
     jsonData["edges"] = nlohmann::json::array();
-    for (const auto& edge : graphManager_->getAllEdges()) {
-        const Node& u = graphManager_->getNode(edge.u_id);
-        const Node& v = graphManager_->getNode(edge.v_id);
+    for (const auto& edge : view.edges) {
+        const Node& u = nodes[edge.first];
+        const Node& v = nodes[edge.second];
         jsonData["edges"].push_back({
             {"startLat", u.coords.lat},
             {"startLon", u.coords.lon},
@@ -148,15 +464,13 @@ void AppController::updateMapJsDisplay() {
             {"endLon", v.coords.lon}
         });
     }
+    jsonData["decimated"] = view.decimated;
 
-    // Include the current route if available
-    std::vector<int> currentPath; // Get this from RouteFinder or store it
-    // For now, let's re-run findRoute if origin/dest are set (not ideal for performance, but good for demo)
-    if (originNodeId_ != -1 && destinationNodeId_ != -1) {
-         currentPath = routeFinder_->findRoute(*graphManager_, originNodeId_, destinationNodeId_);
-    }
-
+    // Include the last computed route, but only while it still matches the endpoints and obstacles;
+    // a stale route is replaced once the background search started by the change completes
     jsonData["route"] = nlohmann::json::array();
+    const std::vector<int> noRoute;
+    const std::vector<int>& currentPath = routeMatchesInputs(currentRoute_) ? currentRoute_.path : noRoute;
     for (int nodeId : currentPath) {
         const Node& node = graphManager_->getNode(nodeId);
         jsonData["route"].push_back({{"id", node.id}, {"lat", node.coords.lat}, {"lon", node.coords.lon}});
@@ -165,11 +479,8 @@ void AppController::updateMapJsDisplay() {
     jsonData["originNodeId"] = originNodeId_;
     jsonData["destinationNodeId"] = destinationNodeId_;
 
-    // Add obstacle node IDs for JS to highlight
-    jsonData["obstacleNodeIds"] = nlohmann::json::array();
-    for (int obsId : graphManager_->getObstacleNodeIds()) {
-        jsonData["obstacleNodeIds"].push_back(obsId);
-    }
+    // Registered obstacle shapes, so JS can drop drawn layers that were cleared
+    jsonData["obstacleShapeIds"] = graphManager_->getObstacleShapeIds();
 
     std::string jsonString = jsonData.dump();
     QString jsCommand = QString("updateMapDisplay(%1);").arg(QString::fromStdString(jsonString));
@@ -8,6 +8,8 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QtConcurrent/QtConcurrent> // For running heavy tasks in a separate thread
+#include <mutex>
+#include <atomic>
 
 #include "map_interface.h"
 #include "graph_manager.h"
@@ -25,13 +27,17 @@ public:
     void loadGraphData(const QString& filePath);
     void findRoute();
     void clearObstacles();
+    void setRoutingAlgorithm(RoutingAlgorithm algorithm);
+    // See GraphManager::setLowMemoryMode; runs on a worker thread and emits lowMemoryModeApplied
+    void setLowMemoryMode(bool enabled);
 
 public slots:
     // Slots to receive signals from MapInterface (JavaScript events)
     void handleMapReady();
     void handleNodeSelectionRequested(int nodeId);
-    void handleObstacleMarkerDrawn(const LatLon& coords);
-    void handleObstacleAreaDrawn(double minLat, double minLon, double maxLat, double maxLon);
+    void handleObstacleShapeChanged(int shapeId, const QString& geoJson);
+    void handleObstacleShapeDeleted(int shapeId);
+    void handleViewportChanged(double minLat, double minLon, double maxLat, double maxLon);
 
 private:
     QWebEngineView* mapView_;
@@ -41,14 +47,67 @@ private:
     int originNodeId_ = -1;
     int destinationNodeId_ = -1;
     RouteSelectionMode currentSelectionMode_ = RouteSelectionMode::None;
+    RoutingAlgorithm routingAlgorithm_ = RoutingAlgorithm::AStar;
+
+    // Last computed route together with the inputs it was computed for. It is stale as soon as
+    // the endpoints or the graph version differ; redraws only serialize it and never search.
+    struct RouteState {
+        int originNodeId = -1;
+        int destinationNodeId = -1;
+        uint64_t graphVersion = 0;
+        std::vector<int> path;
+        bool valid = false;
+    };
+    RouteState currentRoute_;
+    RouteState pendingRoute_; // Inputs of the search in flight; valid while one is running
+    bool routeRequested_ = false; // Report the outcome of the next search via status/routeFound
+
+    // Starts one background search if the current route is stale and no search for the same
+    // inputs is already running. Clears the route when an endpoint is missing.
+    void requestRouteUpdate();
+    void handleRouteComputed(const RouteState& result);
+    void handleGraphUpdated();
+    bool routeMatchesInputs(const RouteState& state) const;
+
+    // Visible map area; updateMapJsDisplay() only sends the graph inside it. Until the map
+    // reports its bounds the whole graph is treated as visible.
+    struct Viewport {
+        double minLat = 0, minLon = 0, maxLat = 0, maxLon = 0;
+        bool known = false;
+    };
+    Viewport viewport_;
+    static constexpr size_t kMaxViewportNodes = 4000; // Level-of-detail budget per redraw
+    // Set before a load starts, since the loaders emit graphUpdated themselves; the first redraw
+    // showing a graph newer than fitMapAfterVersion_ zooms the map to it
+    std::atomic<bool> fitMapToGraph_{false};
+    std::atomic<uint64_t> fitMapAfterVersion_{0};
+    // Set by loadGraphData() while its worker rebuilds the graph; the map shows the load preview
+    // and graphUpdated is ignored until finishLoading(), queued by the worker, redraws once
+    std::atomic<bool> loading_{false};
+    void finishLoading();
+
+    // Draws a sample of a batch of nodes that is still loading (the first batch also moves the
+    // map there); replaced by the real graph on the next redraw. Callable from any thread.
+    void publishLoadPreview(const std::vector<Node>& batch, bool fitMap);
+    static constexpr size_t kMaxPreviewNodesPerBatch = 2000;
 
     // Helper to send data to JS
     void updateMapJsDisplay();
+    // Converts a GeoJSON Feature from the map into an obstacle shape, false if unsupported
+    bool parseObstacleShape(const QString& geoJson, ObstacleShape& shape) const;
+
+    // Rebuilds the ALT landmark tables on a worker thread after graph changes. Changes that
+    // arrive while a rebuild runs are coalesced into one more rebuild.
+    void scheduleLandmarkRebuild();
+    std::mutex landmarkRebuildMutex_;
+    bool landmarkRebuildRunning_ = false;
+    bool landmarkRebuildPending_ = false;
 
 signals:
     // Signals to update the UI (e.g., status messages, enable/disable buttons)
     void statusMessage(const QString& message);
     void routeFound(bool success);
+    void lowMemoryModeApplied(bool enabled); // setLowMemoryMode() finished on its worker thread
 };
 
 #endif // APP_CONTROLLER_H
@@ -0,0 +1,147 @@
+#include "compressed_adjacency.h"
+#include <algorithm> // For std::sort, std::is_sorted
+#include <cmath>     // For std::ceil, std::isinf
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+namespace {
+
+size_t writeVarint(uint64_t value, uint8_t* out) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        if (out) *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+        length++;
+    }
+    if (out) *out = static_cast<uint8_t>(value);
+    return length;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+} // namespace
+
+uint64_t CompressedAdjacency::encodeWeight(double weight_km) {
+    if (std::isinf(weight_km)) return 0;
+    uint64_t units = static_cast<uint64_t>(std::ceil(weight_km / kWeightStepKm));
+    if (static_cast<double>(units) * kWeightStepKm < weight_km) units++; // Never round below the weight
+    return units + 1;
+}
+
+std::shared_ptr<const CompressedAdjacency> CompressedAdjacency::build(const CsrAdjacency& csr) {
+    return build(csr.nodeCount(), [&csr](int index, std::vector<std::pair<int, double>>& row) {
+        for (size_t k = csr.edgeBegin(index); k < csr.edgeEnd(index); ++k) {
+            row.emplace_back(csr.targets[k], csr.weights[k]);
+        }
+    });
+}
+
+std::shared_ptr<const CompressedAdjacency> CompressedAdjacency::build(size_t node_count, const RowSource& rows) {
+    auto graph = std::make_shared<CompressedAdjacency>();
+    graph->node_count_ = node_count;
+
+    // Encodes one row into 'out' (or only measures it with out == nullptr)
+    auto encodeRow = [](size_t index, std::vector<std::pair<int, double>>& row, uint8_t* out) {
+        if (!std::is_sorted(row.begin(), row.end())) std::sort(row.begin(), row.end());
+        size_t length = 0;
+        int previous = static_cast<int>(index);
+        for (size_t k = 0; k < row.size(); ++k) {
+            uint64_t gap = k == 0 ? zigzag(static_cast<int64_t>(row[k].first) - previous)
+                                  : static_cast<uint64_t>(row[k].first - previous);
+            length += writeVarint(gap, out ? out + length : nullptr);
+            length += writeVarint(encodeWeight(row[k].second), out ? out + length : nullptr);
+            previous = row[k].first;
+        }
+        return length;
+    };
+
+    // Pass 1: row sizes
+    std::vector<uint64_t> row_start(node_count + 1, 0);
+    size_t arc_count = 0;
+    #pragma omp parallel reduction(+:arc_count)
+    {
+        std::vector<std::pair<int, double>> row;
+        #pragma omp for schedule(dynamic, 1024)
+        for (size_t i = 0; i < node_count; ++i) {
+            row.clear();
+            rows(static_cast<int>(i), row);
+            row_start[i + 1] = encodeRow(i, row, nullptr);
+            arc_count += row.size();
+        }
+    }
+    for (size_t i = 0; i < node_count; ++i) {
+        row_start[i + 1] += row_start[i];
+    }
+    graph->arc_count_ = arc_count;
+
+    graph->block_base_.resize((node_count >> kBlockShift) + 1);
+    graph->row_offset_.resize(node_count + 1);
+    for (size_t i = 0; i <= node_count; ++i) {
+        if ((i & (kBlockSize - 1)) == 0) graph->block_base_[i >> kBlockShift] = row_start[i];
+        uint64_t offset = row_start[i] - graph->block_base_[i >> kBlockShift];
+        if (offset > std::numeric_limits<uint32_t>::max()) {
+            qCritical() << "CompressedAdjacency: Rows of one block exceed 4 GiB; node degrees are too large.";
+            return nullptr;
+        }
+        graph->row_offset_[i] = static_cast<uint32_t>(offset);
+    }
+
+    // Pass 2: encode each row in place
+    graph->data_.resize(row_start[node_count]);
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int, double>> row;
+        #pragma omp for schedule(dynamic, 1024)
+        for (size_t i = 0; i < node_count; ++i) {
+            row.clear();
+            rows(static_cast<int>(i), row);
+            encodeRow(i, row, graph->data_.data() + row_start[i]);
+        }
+    }
+
+    qDebug() << "CompressedAdjacency: Encoded" << arc_count << "arcs in" << graph->memoryBytes() / 1024 << "KiB ("
+             << (node_count + 1) * sizeof(size_t) / 1024 + arc_count * (sizeof(int) + sizeof(double)) / 1024
+             << "KiB as CSR).";
+    return graph;
+}
+
+size_t CompressedAdjacency::memoryBytes() const {
+    return data_.capacity() + block_base_.capacity() * sizeof(uint64_t) + row_offset_.capacity() * sizeof(uint32_t);
+}
+
+void CompressedAdjacency::decodeRow(int index, std::vector<std::pair<int, double>>& row) const {
+    forEachNeighbor(index, [&row](int target, double weight) { row.emplace_back(target, weight); });
+}
+
+bool CompressedAdjacency::hasArc(int from, int to) const {
+    bool found = false;
+    forEachNeighbor(from, [&found, to](int target, double) { found = found || target == to; });
+    return found;
+}
+
+CsrAdjacency CompressedAdjacency::toCsr() const {
+    CsrAdjacency csr;
+    csr.offsets.assign(node_count_ + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < node_count_; ++i) {
+        size_t degree = 0;
+        forEachNeighbor(static_cast<int>(i), [&degree](int, double) { degree++; });
+        csr.offsets[i + 1] = degree;
+    }
+    for (size_t i = 0; i < node_count_; ++i) {
+        csr.offsets[i + 1] += csr.offsets[i];
+    }
+    csr.targets.resize(csr.offsets[node_count_]);
+    csr.weights.resize(csr.offsets[node_count_]);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < node_count_; ++i) {
+        size_t k = csr.offsets[i];
+        forEachNeighbor(static_cast<int>(i), [&csr, &k](int target, double weight) {
+            csr.targets[k] = target;
+            csr.weights[k++] = weight;
+        });
+    }
+    return csr;
+}
@@ -0,0 +1,88 @@
+#ifndef COMPRESSED_ADJACENCY_H
+#define COMPRESSED_ADJACENCY_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include "data_types.h"
+
+// Adjacency in a compact byte encoding for very large graphs (GraphManager's low-memory mode),
+// iterated by the searches through forEachNeighbor() just like CsrAdjacency.
+//
+// Each row (the neighbors of one node, sorted by target) is a run of varint pairs: the gap to
+// the next target and the weight in units of kWeightStepKm, rounded up. The first gap is
+// zigzag-coded relative to the node itself, which after Hilbert ordering is usually close.
+// Rounding weights up keeps them at or above the haversine length of the edge, so A* stays
+// admissible and consistent. A stored weight of 0 marks a closed edge (infinite weight).
+// Row starts are 32-bit offsets from a 64-bit base per block of kBlockSize rows.
+// A street graph takes about 3-4 bytes per arc instead of 12.
+class CompressedAdjacency {
+public:
+    static constexpr double kWeightStepKm = 1e-5; // 1 cm
+
+    // Fills 'row' with the (target, weight) pairs of node 'index', sorted by target. Called from
+    // several threads at once, twice per row.
+    using RowSource = std::function<void(int index, std::vector<std::pair<int, double>>& row)>;
+
+    static std::shared_ptr<const CompressedAdjacency> build(const CsrAdjacency& csr);
+    static std::shared_ptr<const CompressedAdjacency> build(size_t node_count, const RowSource& rows);
+    CsrAdjacency toCsr() const; // Decoded copy, with the rounded weights
+
+    size_t nodeCount() const { return node_count_; }
+    size_t arcCount() const { return arc_count_; } // Directed arcs (two per undirected edge)
+    size_t memoryBytes() const;
+
+    void decodeRow(int index, std::vector<std::pair<int, double>>& row) const;
+    bool hasArc(int from, int to) const;
+
+    // Calls f(target, weight) for every arc leaving 'index', in target order
+    template <typename F>
+    void forEachNeighbor(int index, F&& f) const {
+        const uint8_t* p = data_.data() + rowBegin(index);
+        const uint8_t* end = data_.data() + rowBegin(index + 1);
+        if (p == end) return;
+        int target = index + unzigzag(readVarint(p));
+        f(target, decodeWeight(readVarint(p)));
+        while (p < end) {
+            target += static_cast<int>(readVarint(p));
+            f(target, decodeWeight(readVarint(p)));
+        }
+    }
+
+private:
+    static constexpr size_t kBlockShift = 6;
+    static constexpr size_t kBlockSize = size_t(1) << kBlockShift;
+
+    size_t rowBegin(size_t index) const { return block_base_[index >> kBlockShift] + row_offset_[index]; }
+
+    static uint64_t readVarint(const uint8_t*& p) {
+        uint64_t value = *p++;
+        if (value < 0x80) return value; // Most gaps fit in one byte
+        value &= 0x7f;
+        for (int shift = 7;; shift += 7) {
+            uint64_t byte = *p++;
+            value |= (byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+    static int unzigzag(uint64_t value) {
+        return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+    }
+    static double decodeWeight(uint64_t units) {
+        return units == 0 ? std::numeric_limits<double>::infinity() : static_cast<double>(units - 1) * kWeightStepKm;
+    }
+    static uint64_t encodeWeight(double weight_km);
+
+    size_t node_count_ = 0;
+    size_t arc_count_ = 0;
+    std::vector<uint8_t> data_;        // All rows back to back
+    std::vector<uint64_t> block_base_; // Byte offset of the first row of each block
+    std::vector<uint32_t> row_offset_; // nodeCount() + 1 row starts, relative to their block base
+};
+
+#endif // COMPRESSED_ADJACENCY_H
@@ -0,0 +1,336 @@
+#include "contraction_hierarchy.h"
+#include <algorithm> // For std::push_heap, std::pop_heap, std::reverse, std::remove_if
+#include <functional> // For std::greater
+#include <limits>
+#include <utility>
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+namespace {
+
+// Upper bound on nodes settled by a single witness search. Hitting it only costs an
+// unnecessary shortcut, never correctness.
+const size_t kWitnessSettleLimit = 500;
+
+struct DynamicArc {
+    int target;
+    double weight;
+    int middle;
+};
+using DynamicGraph = std::vector<std::vector<DynamicArc>>;
+
+struct Shortcut {
+    int from;
+    int to;
+    double weight;
+    int middle;
+};
+
+// Local Dijkstra from 'source' that never enters 'excluded', stopping once the
+// smallest key exceeds 'max_cost'. Distances are left in 'ws'.
+void witnessSearch(const DynamicGraph& graph, int source, int excluded, double max_cost, SearchWorkspace& ws) {
+    ws.reset(graph.size());
+    auto& heap = ws.open_set;
+    ws.update(source, 0.0, -1);
+    heap.push_back({source, 0.0});
+    size_t settled = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<NodeScore>());
+        NodeScore top = heap.back();
+        heap.pop_back();
+        if (ws.isClosed(top.node_index)) continue;
+        if (top.f_score > max_cost || ++settled > kWitnessSettleLimit) break;
+        ws.close(top.node_index);
+        for (const DynamicArc& arc : graph[top.node_index]) {
+            if (arc.target == excluded) continue;
+            double g = top.f_score + arc.weight;
+            if (g < ws.gScore(arc.target)) {
+                ws.update(arc.target, g, top.node_index);
+                heap.push_back({arc.target, g});
+                std::push_heap(heap.begin(), heap.end(), std::greater<NodeScore>());
+            }
+        }
+    }
+}
+
+// Shortcuts required to contract 'node' from the current remaining graph. A pair (u, w) of
+// neighbors needs one unless a witness path strictly shorter than u-node-w exists.
+void findShortcuts(const DynamicGraph& graph, int node, SearchWorkspace& ws, std::vector<Shortcut>& out) {
+    const auto& arcs = graph[node];
+    for (size_t i = 0; i + 1 < arcs.size(); ++i) {
+        int u = arcs[i].target;
+        double max_via = 0.0;
+        for (size_t j = i + 1; j < arcs.size(); ++j) {
+            max_via = std::max(max_via, arcs[i].weight + arcs[j].weight);
+        }
+        witnessSearch(graph, u, node, max_via, ws);
+        for (size_t j = i + 1; j < arcs.size(); ++j) {
+            double via = arcs[i].weight + arcs[j].weight;
+            if (!(ws.gScore(arcs[j].target) < via)) {
+                out.push_back({u, arcs[j].target, via, node});
+            }
+        }
+    }
+}
+
+// Inserts u->v into u's arc list, or lowers the existing arc if the new one is cheaper
+void addOrImproveArc(std::vector<DynamicArc>& arcs, int target, double weight, int middle) {
+    for (DynamicArc& arc : arcs) {
+        if (arc.target == target) {
+            if (weight < arc.weight) {
+                arc.weight = weight;
+                arc.middle = middle;
+            }
+            return;
+        }
+    }
+    arcs.push_back({target, weight, middle});
+}
+
+} // namespace
+
+void ContractionHierarchy::build(std::shared_ptr<const CsrAdjacency> graph) {
+    source_ = graph;
+    rank_.clear();
+    up_offsets_.clear();
+    up_arcs_.clear();
+    shortcut_count_ = 0;
+    if (!graph) return;
+
+    const size_t n = graph->nodeCount();
+    qDebug() << "ContractionHierarchy: Contracting" << n << "nodes...";
+
+    // Mutable copy of the adjacency; parallel edges collapse to their cheapest one
+    DynamicGraph remaining_graph(n);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; ++v) {
+        for (size_t k = graph->edgeBegin(v); k < graph->edgeEnd(v); ++k) {
+            if (graph->targets[k] != static_cast<int>(v)) {
+                addOrImproveArc(remaining_graph[v], graph->targets[k], graph->weights[k], -1);
+            }
+        }
+    }
+
+    std::vector<SearchWorkspace> workspaces(omp_get_max_threads());
+    std::vector<int> priority(n, 0);
+    std::vector<int> contracted_neighbors(n, 0);
+    auto computePriority = [&](int v, SearchWorkspace& ws, std::vector<Shortcut>& scratch) {
+        scratch.clear();
+        findShortcuts(remaining_graph, v, ws, scratch);
+        // Edge difference, plus a uniformity term so contraction spreads over the graph
+        return static_cast<int>(scratch.size()) - static_cast<int>(remaining_graph[v].size())
+               + contracted_neighbors[v];
+    };
+
+    #pragma omp parallel
+    {
+        SearchWorkspace& ws = workspaces[omp_get_thread_num()];
+        std::vector<Shortcut> scratch;
+        #pragma omp for schedule(dynamic, 256)
+        for (size_t v = 0; v < n; ++v) {
+            priority[v] = computePriority(static_cast<int>(v), ws, scratch);
+        }
+    }
+
+    rank_.assign(n, -1);
+    std::vector<std::vector<DynamicArc>> upward(n);
+    std::vector<int> remaining(n);
+    for (size_t v = 0; v < n; ++v) remaining[v] = static_cast<int>(v);
+    std::vector<int> touched_stamp(n, -1);
+    int next_rank = 0;
+    int round = 0;
+
+    while (!remaining.empty()) {
+        // Independent set: nodes whose (priority, index) is smaller than that of every remaining neighbor
+        std::vector<char> selected(remaining.size(), 0);
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t i = 0; i < remaining.size(); ++i) {
+            int v = remaining[i];
+            bool is_minimum = true;
+            for (const DynamicArc& arc : remaining_graph[v]) {
+                int u = arc.target;
+                if (priority[u] < priority[v] || (priority[u] == priority[v] && u < v)) {
+                    is_minimum = false;
+                    break;
+                }
+            }
+            selected[i] = is_minimum;
+        }
+        std::vector<int> batch;
+        for (size_t i = 0; i < remaining.size(); ++i) {
+            if (selected[i]) batch.push_back(remaining[i]);
+        }
+
+        // Witness searches of the whole batch run in parallel against the unchanged graph
+        std::vector<std::vector<Shortcut>> batch_shortcuts(batch.size());
+        #pragma omp parallel
+        {
+            SearchWorkspace& ws = workspaces[omp_get_thread_num()];
+            #pragma omp for schedule(dynamic, 16)
+            for (size_t i = 0; i < batch.size(); ++i) {
+                findShortcuts(remaining_graph, batch[i], ws, batch_shortcuts[i]);
+            }
+        }
+
+        // Contract: the node's current arcs all lead to higher-ranked nodes
+        std::vector<int> touched;
+        for (int v : batch) {
+            rank_[v] = next_rank++;
+            for (const DynamicArc& arc : remaining_graph[v]) {
+                auto& neighbor_arcs = remaining_graph[arc.target];
+                neighbor_arcs.erase(std::remove_if(neighbor_arcs.begin(), neighbor_arcs.end(),
+                                                   [v](const DynamicArc& a) { return a.target == v; }),
+                                    neighbor_arcs.end());
+                contracted_neighbors[arc.target]++;
+                if (touched_stamp[arc.target] != round) {
+                    touched_stamp[arc.target] = round;
+                    touched.push_back(arc.target);
+                }
+            }
+            upward[v] = std::move(remaining_graph[v]);
+            remaining_graph[v] = std::vector<DynamicArc>();
+        }
+        for (const auto& shortcuts : batch_shortcuts) {
+            for (const Shortcut& sc : shortcuts) {
+                addOrImproveArc(remaining_graph[sc.from], sc.to, sc.weight, sc.middle);
+                addOrImproveArc(remaining_graph[sc.to], sc.from, sc.weight, sc.middle);
+            }
+            shortcut_count_ += shortcuts.size();
+        }
+
+        // Only neighbors of contracted nodes can change priority
+        #pragma omp parallel
+        {
+            SearchWorkspace& ws = workspaces[omp_get_thread_num()];
+            std::vector<Shortcut> scratch;
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < touched.size(); ++i) {
+                priority[touched[i]] = computePriority(touched[i], ws, scratch);
+            }
+        }
+
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                       [this](int v) { return rank_[v] >= 0; }),
+                        remaining.end());
+        ++round;
+    }
+
+    // Freeze the upward arcs into CSR form
+    up_offsets_.assign(n + 1, 0);
+    for (size_t v = 0; v < n; ++v) {
+        up_offsets_[v + 1] = up_offsets_[v] + upward[v].size();
+    }
+    up_arcs_.resize(up_offsets_[n]);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; ++v) {
+        size_t k = up_offsets_[v];
+        for (const DynamicArc& arc : upward[v]) {
+            up_arcs_[k++] = { arc.target, arc.weight, arc.middle };
+        }
+    }
+
+    qDebug() << "ContractionHierarchy: Done in" << round << "rounds," << shortcut_count_ << "shortcuts added.";
+}
+
+std::vector<int> ContractionHierarchy::query(int source, int target,
+                                             SearchWorkspace& forward, SearchWorkspace& backward) const {
+    if (source == target) return { source };
+
+    const size_t n = rank_.size();
+    forward.reset(n);
+    backward.reset(n);
+    auto push = [](SearchWorkspace& ws, int index, double key) {
+        ws.open_set.push_back({index, key});
+        std::push_heap(ws.open_set.begin(), ws.open_set.end(), std::greater<NodeScore>());
+    };
+    auto prune = [](SearchWorkspace& ws) {
+        while (!ws.open_set.empty() && ws.isClosed(ws.open_set.front().node_index)) {
+            std::pop_heap(ws.open_set.begin(), ws.open_set.end(), std::greater<NodeScore>());
+            ws.open_set.pop_back();
+        }
+    };
+
+    forward.update(source, 0.0, -1);
+    push(forward, source, 0.0);
+    backward.update(target, 0.0, -1);
+    push(backward, target, 0.0);
+
+    double best_cost = std::numeric_limits<double>::infinity();
+    int meeting_node = -1;
+    bool forward_turn = true;
+
+    // Each side runs until its smallest key can no longer improve the best meeting cost
+    while (true) {
+        prune(forward);
+        prune(backward);
+        bool forward_active = !forward.open_set.empty() && forward.open_set.front().f_score < best_cost;
+        bool backward_active = !backward.open_set.empty() && backward.open_set.front().f_score < best_cost;
+        if (!forward_active && !backward_active) break;
+
+        bool is_forward = forward_active && (!backward_active || forward_turn);
+        forward_turn = !forward_turn;
+        SearchWorkspace& self = is_forward ? forward : backward;
+        const SearchWorkspace& other = is_forward ? backward : forward;
+
+        std::pop_heap(self.open_set.begin(), self.open_set.end(), std::greater<NodeScore>());
+        int current = self.open_set.back().node_index;
+        self.open_set.pop_back();
+        self.close(current);
+
+        double current_g = self.gScore(current);
+        double through = current_g + other.gScore(current);
+        if (through < best_cost) {
+            best_cost = through;
+            meeting_node = current;
+        }
+
+        for (size_t k = up_offsets_[current]; k < up_offsets_[current + 1]; ++k) {
+            const Arc& arc = up_arcs_[k];
+            double g = current_g + arc.weight;
+            if (g < self.gScore(arc.target)) {
+                self.update(arc.target, g, current);
+                push(self, arc.target, g);
+            }
+        }
+    }
+
+    if (meeting_node == -1) return {};
+
+    // Upward chain source -> meeting node, then meeting node -> target, unpacking each arc
+    std::vector<int> chain;
+    for (int v = meeting_node; v != -1; v = forward.parent(v)) chain.push_back(v);
+    std::reverse(chain.begin(), chain.end());
+
+    std::vector<int> path = { source };
+    for (size_t i = 1; i < chain.size(); ++i) {
+        unpackArc(chain[i - 1], chain[i], path);
+    }
+    for (int v = meeting_node; backward.parent(v) != -1; v = backward.parent(v)) {
+        unpackArc(v, backward.parent(v), path);
+    }
+    return path;
+}
+
+const ContractionHierarchy::Arc* ContractionHierarchy::findUpwardArc(int lower, int higher) const {
+    for (size_t k = up_offsets_[lower]; k < up_offsets_[lower + 1]; ++k) {
+        if (up_arcs_[k].target == higher) return &up_arcs_[k];
+    }
+    return nullptr;
+}
+
+void ContractionHierarchy::unpackArc(int from, int to, std::vector<int>& path) const {
+    // Explicit stack: shortcut chains can nest deeply on large graphs
+    std::vector<std::pair<int, int>> pending = { { from, to } };
+    while (!pending.empty()) {
+        auto [a, b] = pending.back();
+        pending.pop_back();
+        const Arc* arc = rank_[a] < rank_[b] ? findUpwardArc(a, b) : findUpwardArc(b, a);
+        if (!arc || arc->middle < 0) {
+            path.push_back(b);
+            continue;
+        }
+        // a -> middle must be emitted before middle -> b
+        pending.push_back({ arc->middle, b });
+        pending.push_back({ a, arc->middle });
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "data_types.h"
+#include "search_workspace.h"
+
+// Contraction Hierarchies (CH) over the triangulated graph.
+//
+// Preprocessing contracts nodes in order of a priority (edge difference + contracted neighbors).
+// Each round picks an independent set of nodes that are local priority minima and runs their
+// witness searches in parallel (OpenMP) on the current remaining graph. A shortcut u-w via v is
+// added unless a witness path strictly shorter than u-v-w exists, which keeps simultaneous
+// contraction of independent nodes exact.
+//
+// Queries run a bidirectional Dijkstra that only follows arcs towards higher-ranked nodes.
+// Shortcuts remember the node they bypass, so the result unpacks to the original node sequence.
+// Obstacles and edge weight overrides are not part of the hierarchy; RouteFinder falls back to
+// A* while any are set.
+class ContractionHierarchy {
+public:
+    // Builds the hierarchy for 'graph'. Keeps a reference to it to detect stale hierarchies.
+    void build(std::shared_ptr<const CsrAdjacency> graph);
+
+    bool isBuiltFor(const std::shared_ptr<const CsrAdjacency>& graph) const {
+        return graph && source_ == graph;
+    }
+    size_t shortcutCount() const { return shortcut_count_; }
+
+    // Shortest path between two dense node indices, fully unpacked (source first).
+    // Returns an empty vector if the target is unreachable.
+    std::vector<int> query(int source, int target, SearchWorkspace& forward, SearchWorkspace& backward) const;
+
+private:
+    struct Arc {
+        int target;
+        double weight;
+        int middle; // Contracted node this shortcut bypasses, -1 for an original edge
+    };
+
+    // Appends the original nodes of the arc from -> to (excluding 'from', including 'to')
+    void unpackArc(int from, int to, std::vector<int>& path) const;
+    const Arc* findUpwardArc(int lower, int higher) const;
+
+    std::shared_ptr<const CsrAdjacency> source_; // Graph the hierarchy was built from
+    std::vector<int> rank_;                      // Contraction order, indexed by dense node index
+    std::vector<size_t> up_offsets_;             // CSR over 'up_arcs_'
+    std::vector<Arc> up_arcs_;                   // Arcs from a node to higher-ranked neighbors
+    size_t shortcut_count_ = 0;
+};
+
+#endif // CONTRACTION_HIERARCHY_H
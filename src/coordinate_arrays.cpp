@@ -0,0 +1,190 @@
+#include "coordinate_arrays.h"
+#include <algorithm> // For std::min
+#include <cmath>     // For std::sin, std::cos, std::atan2, std::sqrt
+#include <omp.h>     // For OpenMP
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define COORDINATE_ARRAYS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr double kEarthRadiusKm = 6371.0; // Same radius as haversineDistance
+
+// haversineDistance with both cosines given; the same operations in the same order
+inline double haversineKm(double lat1, double lon1, double cos_lat1, double lat2, double lon2, double cos_lat2) {
+    double dLat = (lat2 - lat1) * M_PI / 180.0;
+    double dLon = (lon2 - lon1) * M_PI / 180.0;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               cos_lat1 * cos_lat2 *
+               std::sin(dLon / 2) * std::sin(dLon / 2);
+    double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+    return kEarthRadiusKm * c;
+}
+
+// Distances for positions [begin, end) of the query
+void distancesScalar(const double* lats, const double* lons, const double* cos_lats,
+                     double lat, double lon, double cos_lat, const int* indices, size_t begin, size_t end, double* out) {
+    for (size_t i = begin; i < end; ++i) {
+        size_t j = indices ? static_cast<size_t>(indices[i]) : i;
+        out[i] = haversineKm(lat, lon, cos_lat, lats[j], lons[j], cos_lats[j]);
+    }
+}
+
+#ifdef COORDINATE_ARRAYS_AVX2
+
+// Half angles and sqrt(a) up to this bound (about 640 km of latitude) use the series below;
+// their first omitted terms are below 1e-20 relative
+constexpr double kSeriesLimit = 0.05;
+
+__attribute__((target("avx2,fma")))
+inline __m256d sinSeries(__m256d x) {
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(-1.0 / 39916800.0);
+    p = _mm256_fmadd_pd(p, x2, _mm256_set1_pd(1.0 / 362880.0));
+    p = _mm256_fmadd_pd(p, x2, _mm256_set1_pd(-1.0 / 5040.0));
+    p = _mm256_fmadd_pd(p, x2, _mm256_set1_pd(1.0 / 120.0));
+    p = _mm256_fmadd_pd(p, x2, _mm256_set1_pd(-1.0 / 6.0));
+    return _mm256_fmadd_pd(_mm256_mul_pd(p, x2), x, x);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256d asinSeries(__m256d x) {
+    __m256d z = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(143.0 / 10240.0);
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(231.0 / 13312.0));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(63.0 / 2816.0));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(35.0 / 1152.0));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(5.0 / 112.0));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(3.0 / 40.0));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(1.0 / 6.0));
+    return _mm256_fmadd_pd(_mm256_mul_pd(p, z), x, x);
+}
+
+__attribute__((target("avx2,fma")))
+void distancesAvx2(const double* lats, const double* lons, const double* cos_lats,
+                   double lat, double lon, double cos_lat, const int* indices, size_t count, double* out) {
+    const __m256d lat1 = _mm256_set1_pd(lat);
+    const __m256d lon1 = _mm256_set1_pd(lon);
+    const __m256d cos1 = _mm256_set1_pd(cos_lat);
+    const __m256d pi = _mm256_set1_pd(M_PI);
+    const __m256d deg = _mm256_set1_pd(180.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d limit = _mm256_set1_pd(kSeriesLimit);
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m256d two_r = _mm256_set1_pd(2.0 * kEarthRadiusKm);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d lat2, lon2, cos2;
+        if (indices) {
+            __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i));
+            lat2 = _mm256_i32gather_pd(lats, idx, 8);
+            lon2 = _mm256_i32gather_pd(lons, idx, 8);
+            cos2 = _mm256_i32gather_pd(cos_lats, idx, 8);
+        } else {
+            lat2 = _mm256_loadu_pd(lats + i);
+            lon2 = _mm256_loadu_pd(lons + i);
+            cos2 = _mm256_loadu_pd(cos_lats + i);
+        }
+        // Degrees to radians exactly as the scalar formula rounds it
+        __m256d half_dlat = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(lat2, lat1), pi), deg), half);
+        __m256d half_dlon = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(lon2, lon1), pi), deg), half);
+        __m256d in_range = _mm256_and_pd(_mm256_cmp_pd(_mm256_and_pd(half_dlat, abs_mask), limit, _CMP_LE_OQ),
+                                         _mm256_cmp_pd(_mm256_and_pd(half_dlon, abs_mask), limit, _CMP_LE_OQ));
+        if (_mm256_movemask_pd(in_range) != 0xF) {
+            // Far apart (or NaN): the exact formula for these four
+            distancesScalar(lats, lons, cos_lats, lat, lon, cos_lat, indices, i, i + 4, out);
+            continue;
+        }
+
+        __m256d s_lat = sinSeries(half_dlat);
+        __m256d s_lon = sinSeries(half_dlon);
+        __m256d a = _mm256_add_pd(_mm256_mul_pd(s_lat, s_lat),
+                                  _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(cos1, cos2), s_lon), s_lon));
+        __m256d root = _mm256_sqrt_pd(a);
+        if (_mm256_movemask_pd(_mm256_cmp_pd(root, limit, _CMP_LE_OQ)) != 0xF) {
+            distancesScalar(lats, lons, cos_lats, lat, lon, cos_lat, indices, i, i + 4, out);
+            continue;
+        }
+        // 2 atan2(sqrt(a), sqrt(1 - a)) == 2 asin(sqrt(a))
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(two_r, asinSeries(root)));
+    }
+    distancesScalar(lats, lons, cos_lats, lat, lon, cos_lat, indices, i, count, out);
+}
+
+#endif // COORDINATE_ARRAYS_AVX2
+
+} // namespace
+
+void CoordinateArrays::build(const std::vector<Node>& nodes) {
+    const size_t n = nodes.size();
+    lat_.resize(n);
+    lon_.resize(n);
+    cos_lat_.resize(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        lat_[i] = nodes[i].coords.lat;
+        lon_[i] = nodes[i].coords.lon;
+        cos_lat_[i] = std::cos(nodes[i].coords.lat * M_PI / 180.0);
+    }
+}
+
+void CoordinateArrays::clear() {
+    lat_.clear();
+    lon_.clear();
+    cos_lat_.clear();
+}
+
+bool CoordinateArrays::hasAvx2() {
+#ifdef COORDINATE_ARRAYS_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+double CoordinateArrays::distanceKm(size_t i, size_t j) const {
+    return haversineKm(lat_[i], lon_[i], cos_lat_[i], lat_[j], lon_[j], cos_lat_[j]);
+}
+
+void CoordinateArrays::distancesKm(size_t from, const int* indices, size_t count, double* out) const {
+    if (count == 0) return;
+    distancesFrom(lat_[from], lon_[from], cos_lat_[from], indices, 0, count, out);
+}
+
+void CoordinateArrays::distancesKm(double lat, double lon, const int* indices, size_t count, double* out) const {
+    if (count == 0) return;
+    distancesFrom(lat, lon, std::cos(lat * M_PI / 180.0), indices, 0, count, out);
+}
+
+void CoordinateArrays::rangeDistancesKm(size_t from, size_t begin, size_t end, double* out) const {
+    if (end <= begin) return;
+    distancesFrom(lat_[from], lon_[from], cos_lat_[from], nullptr, begin, end - begin, out);
+}
+
+void CoordinateArrays::distancesFromNode(size_t from, std::vector<double>& out) const {
+    const size_t n = size();
+    const size_t chunk = 4096;
+    out.resize(n);
+    #pragma omp parallel for
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        rangeDistancesKm(from, begin, std::min(n, begin + chunk), out.data() + begin);
+    }
+}
+
+void CoordinateArrays::distancesFrom(double lat, double lon, double cos_lat, const int* indices, size_t offset,
+                                     size_t count, double* out) const {
+    const double* lats = lat_.data() + offset;
+    const double* lons = lon_.data() + offset;
+    const double* cos_lats = cos_lat_.data() + offset;
+#ifdef COORDINATE_ARRAYS_AVX2
+    if (hasAvx2()) {
+        distancesAvx2(lats, lons, cos_lats, lat, lon, cos_lat, indices, count, out);
+        return;
+    }
+#endif
+    distancesScalar(lats, lons, cos_lats, lat, lon, cos_lat, indices, 0, count, out);
+}
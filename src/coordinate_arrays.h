@@ -0,0 +1,53 @@
+#ifndef COORDINATE_ARRAYS_H
+#define COORDINATE_ARRAYS_H
+
+#include <vector>
+#include <cstddef>
+
+#include "data_types.h"
+
+// Node coordinates as a structure of arrays, for scans that only need positions (A* heuristics,
+// circle obstacles, landmark selection).
+//
+// Latitude and longitude stay in degrees and double precision, and cos(lat) is precomputed per
+// node, so a distance evaluates the same formula as haversineDistance minus its two cosines.
+// The bulk kernels run four distances per AVX2 instruction when the CPU supports it (checked
+// once at run time) and the scalar formula otherwise. Within about 600 km the AVX2 path replaces
+// sin and asin by series accurate to the last bit or two; results differ from haversineDistance
+// by no more than ordinary rounding, which keeps the A* heuristic consistent with the edge
+// weights. Floats would not: they round coordinates to about 0.2 m.
+class CoordinateArrays {
+public:
+    // Copies the coordinates of 'nodes'; position i belongs to dense index i
+    void build(const std::vector<Node>& nodes);
+    void clear();
+    size_t size() const { return lat_.size(); }
+
+    const double* lats() const { return lat_.data(); }
+    const double* lons() const { return lon_.data(); }
+
+    // Haversine distance in kilometers between the nodes at dense indices i and j
+    double distanceKm(size_t i, size_t j) const;
+
+    // Haversine distances in kilometers from node 'from' (or from the point lat/lon) to the nodes
+    // indices[0..count), written to out[0..count)
+    void distancesKm(size_t from, const int* indices, size_t count, double* out) const;
+    void distancesKm(double lat, double lon, const int* indices, size_t count, double* out) const;
+    // Same for the consecutive nodes [begin, end), written to out[0..end - begin)
+    void rangeDistancesKm(size_t from, size_t begin, size_t end, double* out) const;
+    // Distances from node 'from' to every node, resizing 'out' to size(); runs in parallel chunks
+    void distancesFromNode(size_t from, std::vector<double>& out) const;
+
+    static bool hasAvx2(); // Whether distancesKm() takes the AVX2 path on this CPU
+
+private:
+    // With indices == nullptr, to the nodes offset..offset + count - 1
+    void distancesFrom(double lat, double lon, double cos_lat, const int* indices, size_t offset, size_t count,
+                       double* out) const;
+
+    std::vector<double> lat_;
+    std::vector<double> lon_;
+    std::vector<double> cos_lat_;
+};
+
+#endif // COORDINATE_ARRAYS_H
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cmath>  // For std::abs
 #include <limits> // For std::numeric_limits
 
 // Struct to represent a geographic point
@@ -28,14 +30,13 @@ struct LatLon {
 struct Node {
     int id;
     LatLon coords;
-    std::vector<int> neighbors; // Adjacency list
-    bool is_obstacle; // Flag set by user input
+    // Obstacle state is kept by GraphManager in a bitset indexed by dense node index
 
     // Default constructor
-    Node() : id(-1), is_obstacle(false) {}
+    Node() : id(-1) {}
 
     // Parameterized constructor
-    Node(int id, double lat, double lon) : id(id), coords(lat, lon), is_obstacle(false) {}
+    Node(int id, double lat, double lon) : id(id), coords(lat, lon) {}
 };
 
 // Struct to represent a graph edge
@@ -51,6 +52,26 @@ struct Edge {
     Edge(int u, int v, double w) : u_id(u), v_id(v), weight(w) {}
 };
 
+// Compressed-sparse-row (CSR) adjacency, indexed by dense node index
+// (the position of a node in GraphManager's node vector).
+// Neighbors of node i are targets[offsets[i] .. offsets[i + 1]), and weights[k]
+// is the cost of the edge to targets[k]. Built once after triangulation.
+struct CsrAdjacency {
+    std::vector<size_t> offsets; // nodeCount() + 1 entries
+    std::vector<int> targets;    // Dense indices of neighbor nodes
+    std::vector<double> weights; // Edge weights (km), parallel to 'targets'
+
+    size_t nodeCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t edgeBegin(int index) const { return offsets[index]; }
+    size_t edgeEnd(int index) const { return offsets[index + 1]; }
+
+    // Calls f(target, weight) for every arc leaving 'index'; same interface as CompressedAdjacency
+    template <typename F>
+    void forEachNeighbor(int index, F&& f) const {
+        for (size_t k = offsets[index]; k < offsets[index + 1]; ++k) f(targets[k], weights[k]);
+    }
+};
+
 // Enum for different route selection modes (useful for future expansion)
 enum class RouteSelectionMode {
     None,
@@ -60,4 +81,13 @@ enum class RouteSelectionMode {
     ClearObstacle
 };
 
+// Search algorithm used by RouteFinder::findRoute
+enum class RoutingAlgorithm {
+    AStar,                  // Unidirectional A* with haversine heuristic
+    BidirectionalAStar,     // Forward + backward A* with average (consistent) potentials
+    ContractionHierarchies, // Bidirectional upward search over a precomputed hierarchy
+    ALT,                    // A* with landmark (triangle inequality) lower bounds
+    Incremental             // LPA*: repairs the previous search after obstacle edits
+};
+
 #endif // DATA_TYPES_H
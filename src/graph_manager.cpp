@@ -1,8 +1,16 @@
 #include "graph_manager.h"
-#include <fstream>
-#include <sstream>
-#include <algorithm> // For std::find, std::min, std::max
+#include "graph_snapshot.h"
+#include "osm_importer.h"
+#include "mapped_file.h"
+#include <QFile>
+#include <QSaveFile>
+#include <charconv>  // For std::from_chars
+#include <cstring>   // For std::memchr
+#include <algorithm> // For std::sort, std::unique, std::min, std::max, std::set_difference
+#include <iterator>  // For std::back_inserter
 #include <limits>    // For std::numeric_limits
+#include <cmath>     // For std::isinf, std::cos, std::sqrt
+#include <unordered_set>
 #include <omp.h>     // For OpenMP
 
 // Haversine distance function (approximation, consider using a more precise one if needed)
@@ -24,59 +32,420 @@ double haversineDistance(double lat1, double lon1, double lat2, double lon2) {
 }
 
 
-bool GraphManager::loadNodesFromFile(const std::string& filepath) {
+namespace {
+
+// A newline-aligned slice of a node CSV file and what parsing it produced
+struct CsvChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::vector<Node> nodes;
+    std::vector<std::pair<size_t, std::string>> errors; // (line within the chunk, from 0; message)
+    size_t lines = 0;
+};
+
+const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p;
+}
+
+// Parses one field of a row and the comma after it (none after the last one, where further
+// columns are ignored). Leading and trailing blanks and a leading '+' are accepted.
+template <typename T>
+bool parseCsvField(const char*& p, const char* end, T& value, bool last, const char* name, std::string& error) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') ++p;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        error = std::string("invalid ") + name;
+        return false;
+    }
+    p = skipBlanks(result.ptr, end);
+    if (p < end && *p != ',') {
+        error = std::string("unexpected text after ") + name;
+        return false;
+    }
+    if (!last) {
+        if (p == end) {
+            error = std::string("missing field after ") + name;
+            return false;
+        }
+        ++p;
+    }
+    return true;
+}
+
+// Parses "id,lat,lon" rows; blank lines are skipped, malformed rows recorded with their line
+void parseCsvChunk(CsvChunk& chunk) {
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+        const char* line_end = eol ? eol : chunk.end;
+        const char* next = eol ? eol + 1 : chunk.end;
+        if (line_end > p && line_end[-1] == '\r') --line_end;
+        size_t line = chunk.lines++;
+
+        if (skipBlanks(p, line_end) != line_end) {
+            int id;
+            double lat, lon;
+            std::string error;
+            const char* q = p;
+            if (parseCsvField(q, line_end, id, false, "id", error) &&
+                parseCsvField(q, line_end, lat, false, "latitude", error) &&
+                parseCsvField(q, line_end, lon, true, "longitude", error)) {
+                if (lat >= -90.0 && lat <= 90.0 && lon >= -180.0 && lon <= 180.0) { // Also rejects NaN
+                    chunk.nodes.emplace_back(id, lat, lon);
+                } else {
+                    error = "coordinates out of range";
+                }
+            }
+            if (!error.empty()) {
+                chunk.errors.push_back({ line, error + ": \"" + std::string(p, std::min<size_t>(line_end - p, 80)) + "\"" });
+            }
+        }
+        p = next;
+    }
+}
+
+} // namespace
+
+bool GraphManager::loadNodesFromFile(const std::string& filepath, const LoadProgressCallback& progress) {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
     qDebug() << "GraphManager: Loading nodes from" << QString::fromStdString(filepath);
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
+    QFile file(QString::fromStdString(filepath));
+    if (!file.open(QIODevice::ReadOnly)) {
         qCritical() << "Error: Could not open node file:" << QString::fromStdString(filepath);
         return false;
     }
 
-    nodes_.clear();
-    node_id_to_index_map_.clear();
-    node_coords_to_id_map_.clear(); // Clear for triangulation mapping
+    const MappedFile contents(file);
+    const char* data = contents.data();
+    const size_t data_size = contents.size();
+    const char* end = data + data_size;
 
-    std::string line;
-    // Skip header if any
-    std::getline(file, line); // Assuming first line is header: "id,lat,lon"
+    // Skip header: the first line is assumed to be "id,lat,lon"
+    const char* body = data_size ? static_cast<const char*>(std::memchr(data, '\n', data_size)) : nullptr;
+    body = body ? body + 1 : end;
 
-    int count = 0;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string segment;
-        int id;
-        double lat, lon;
-
-        if (std::getline(ss, segment, ',')) {
-            id = std::stoi(segment);
-        } else continue;
-        if (std::getline(ss, segment, ',')) {
-            lat = std::stod(segment);
-        } else continue;
-        if (std::getline(ss, segment, ',')) {
-            lon = std::stod(segment);
-        } else continue;
-
-        nodes_.emplace_back(id, lat, lon);
-        node_id_to_index_map_[id] = nodes_.size() - 1;
-        node_coords_to_id_map_[cv::Point2f(static_cast<float>(lon), static_cast<float>(lat))] = id;
-        count++;
-    }
-    qDebug() << "GraphManager: Loaded" << count << "nodes.";
-
-    // Optional: Parallelize initial adjacency list resizing
-    adj_list_.resize(nodes_.size());
+    // Newline-aligned chunks, several per thread so uneven rows still balance and progress
+    // can be reported along the way
+    std::vector<CsvChunk> chunks;
+    const size_t thread_count = static_cast<size_t>(omp_get_max_threads());
+    const size_t body_size = static_cast<size_t>(end - body);
+    const size_t chunk_size = std::max<size_t>(1 << 20, body_size / (8 * thread_count) + 1);
+    for (const char* p = body; p < end;) {
+        const char* q = p + std::min(chunk_size, static_cast<size_t>(end - p));
+        if (q < end) {
+            const char* eol = static_cast<const char*>(std::memchr(q, '\n', end - q));
+            q = eol ? eol + 1 : end;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = p;
+        chunks.back().end = q;
+        p = q;
+    }
+    // Parsed in file order, one chunk per thread at a time, so the first nodes can be shown
+    // while the rest of the file is still being read
+    for (size_t first = 0; first < chunks.size(); first += thread_count) {
+        const size_t last = std::min(chunks.size(), first + thread_count);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = first; c < last; ++c) {
+            parseCsvChunk(chunks[c]);
+        }
+        if (progress) {
+            std::vector<Node> batch;
+            for (size_t c = first; c < last; ++c) {
+                batch.insert(batch.end(), chunks[c].nodes.begin(), chunks[c].nodes.end());
+            }
+            progress(batch, static_cast<size_t>(chunks[last - 1].end - data), data_size);
+        }
+    }
+
+    // Concatenate in file order; chunk line counts turn local line numbers into file lines.
+    // The new node set is assembled aside: the current graph stays intact until it is complete.
+    std::vector<size_t> offsets(chunks.size() + 1, 0);
+    std::vector<std::string> errors;
+    size_t error_count = 0;
+    size_t line_base = 2; // The header is line 1
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        offsets[c + 1] = offsets[c] + chunks[c].nodes.size();
+        for (const auto& error : chunks[c].errors) {
+            if (errors.size() < kMaxReportedLoadErrors) {
+                errors.push_back("line " + std::to_string(line_base + error.first) + ": " + error.second);
+                qWarning() << "GraphManager: Skipping malformed row," << QString::fromStdString(errors.back());
+            }
+            error_count++;
+        }
+        line_base += chunks[c].lines;
+    }
+    std::vector<Node> nodes(offsets.back());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        std::copy(chunks[c].nodes.begin(), chunks[c].nodes.end(), nodes.begin() + offsets[c]);
+    }
+    std::unordered_map<int, size_t> id_to_index;
+    id_to_index.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        id_to_index[nodes[i].id] = i;
+    }
+    qDebug() << "GraphManager: Loaded" << nodes.size() << "nodes from" << chunks.size() << "chunks,"
+             << error_count << "malformed rows skipped.";
+
+    // Edges and adjacency refer to the previous node set; they are rebuilt by performTriangulation().
+    // They are withdrawn, and the version moved on, before the node set changes under them.
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_.clear();
+        base_adjacency_.reset();
+        adjacency_.reset();
+        compressed_base_.reset();
+        compressed_adjacency_.reset();
+    }
+    edge_count_ = 0;
+    edge_overrides_.clear(); // Keyed by dense index, meaningless for the new node set
+    graph_version_++;
+
+    nodes_.swap(nodes);
+    node_id_to_index_map_.swap(id_to_index);
+    load_errors_.swap(errors);
+    load_error_count_ = error_count;
+    reorderNodesAlongHilbertCurve();
+    resetNodeState();
+    spatial_index_.build(nodes_);
+    region_index_.build(nodes_);
+    resetObstacleLog();
 
     // Signal that the graph has been loaded
     emit graphUpdated();
     return true;
 }
 
+bool GraphManager::loadOsmFile(const std::string& filepath) {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+    qDebug() << "GraphManager: Importing OpenStreetMap extract" << QString::fromStdString(filepath);
+    OsmRoadNetwork network;
+    std::string error;
+    if (!importOsmFile(filepath, network, error)) {
+        qCritical() << "Error: Could not import OpenStreetMap file" << QString::fromStdString(filepath) << ":"
+                    << QString::fromStdString(error);
+        return false;
+    }
+
+    nodes_ = std::move(network.nodes);
+    node_id_to_index_map_.clear();
+    node_id_to_index_map_.reserve(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        node_id_to_index_map_[nodes_[i].id] = i;
+    }
+    node_coords_to_id_map_.clear(); // Edges come from the streets, not from triangulation
+    load_errors_.clear();
+    load_error_count_ = 0;
+    reorderNodesAlongHilbertCurve();
+    resetNodeState();
+    spatial_index_.build(nodes_);
+    region_index_.build(nodes_);
+
+    // Edges refer to node IDs, which the reordering keeps
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_ = std::move(network.edges);
+    }
+    edge_overrides_.clear();
+    buildAdjacency();
+    graph_version_++;
+    resetObstacleLog();
+
+    qDebug() << "GraphManager: Imported" << nodes_.size() << "nodes and" << edge_count_ << "street edges.";
+    emit graphUpdated();
+    return true;
+}
+
+void GraphManager::resetNodeState() {
+    // Obstacles and shapes refer to dense indices of the previous node set
+    obstacles_.resize(nodes_.size());
+    manual_obstacles_.resize(nodes_.size());
+    shape_refcount_.assign(nodes_.size(), 0);
+    obstacle_shapes_.clear();
+    coordinates_.build(nodes_);
+}
+
+bool GraphManager::saveSnapshot(const std::string& filepath) const {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_); // Keeps edges_ and the base in step
+    if (low_memory_) {
+        // Only the rounded weights are left; a snapshot of them would outlive the mode
+        qDebug() << "GraphManager: Snapshot not saved in low-memory mode.";
+        return false;
+    }
+    const std::shared_ptr<const CsrAdjacency> base = base_adjacency_;
+    if (!base) {
+        qWarning() << "GraphManager: No triangulated graph to save as a snapshot.";
+        return false;
+    }
+    const std::vector<Edge>& edges = edges_;
+    // QSaveFile writes to a temporary file and renames it on commit, so a crash never leaves
+    // a truncated snapshot behind
+    QSaveFile file(QString::fromStdString(filepath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "GraphManager: Could not write snapshot" << QString::fromStdString(filepath)
+                   << file.errorString();
+        return false;
+    }
+
+    const size_t n = nodes_.size();
+    std::vector<int> ids(n);
+    std::vector<double> lats(n), lons(n);
+    for (size_t i = 0; i < n; ++i) {
+        ids[i] = nodes_[i].id;
+        lats[i] = nodes_[i].coords.lat;
+        lons[i] = nodes_[i].coords.lon;
+    }
+    std::vector<int> edge_u(edges.size()), edge_v(edges.size());
+    std::vector<double> edge_weights(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        edge_u[i] = edges[i].u_id;
+        edge_v[i] = edges[i].v_id;
+        edge_weights[i] = edges[i].weight;
+    }
+
+    SnapshotWriter writer(file);
+    writer.writeValue(kSnapshotMagic);
+    writer.writeValue(kSnapshotFormatVersion);
+    writer.writeValue(kSnapshotByteOrderMark);
+    writer.writeValue(static_cast<uint32_t>(sizeof(size_t)));
+    writer.writeValue(static_cast<uint32_t>(0)); // Reserved, keeps the sections 8-byte aligned
+    writer.writeArray(ids);
+    writer.writeArray(lats);
+    writer.writeArray(lons);
+    writer.writeArray(edge_u);
+    writer.writeArray(edge_v);
+    writer.writeArray(edge_weights);
+    writer.writeArray(base->offsets);
+    writer.writeArray(base->targets);
+    writer.writeArray(base->weights);
+    spatial_index_.save(writer);
+    region_index_.save(writer);
+    if (!writer.ok() || !file.commit()) {
+        qWarning() << "GraphManager: Failed to write snapshot" << QString::fromStdString(filepath)
+                   << file.errorString();
+        return false;
+    }
+    qDebug() << "GraphManager: Saved snapshot with" << n << "nodes and" << edges.size() << "edges to"
+             << QString::fromStdString(filepath);
+    return true;
+}
+
+bool GraphManager::loadSnapshot(const std::string& filepath) {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+    qDebug() << "GraphManager: Loading snapshot" << QString::fromStdString(filepath);
+    QFile file(QString::fromStdString(filepath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "GraphManager: Could not open snapshot" << QString::fromStdString(filepath);
+        return false;
+    }
+    const MappedFile contents(file);
+    SnapshotReader reader(contents.data(), contents.size());
+    char magic[sizeof(kSnapshotMagic)] = {};
+    uint32_t version = 0, byte_order = 0, size_t_bytes = 0, reserved = 0;
+    reader.readValue(magic);
+    reader.readValue(version);
+    reader.readValue(byte_order);
+    reader.readValue(size_t_bytes);
+    reader.readValue(reserved);
+    if (!reader.ok() || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0) {
+        qWarning() << "GraphManager: Not a graph snapshot:" << QString::fromStdString(filepath);
+        return false;
+    }
+    if (version != kSnapshotFormatVersion || byte_order != kSnapshotByteOrderMark || size_t_bytes != sizeof(size_t)) {
+        qWarning() << "GraphManager: Snapshot" << QString::fromStdString(filepath) << "has format version" << version
+                   << "for another architecture or version; expected" << kSnapshotFormatVersion;
+        return false;
+    }
+
+    // Read everything into locals first so a corrupt snapshot leaves the current graph untouched
+    std::vector<int> ids, edge_u, edge_v;
+    std::vector<double> lats, lons, edge_weights;
+    auto csr = std::make_shared<CsrAdjacency>();
+    reader.readArray(ids);
+    reader.readArray(lats);
+    reader.readArray(lons);
+    reader.readArray(edge_u);
+    reader.readArray(edge_v);
+    reader.readArray(edge_weights);
+    reader.readArray(csr->offsets);
+    reader.readArray(csr->targets);
+    reader.readArray(csr->weights);
+    const size_t n = ids.size();
+    SpatialIndex spatial_index;
+    PackedRTree region_index;
+    bool valid = reader.ok() && spatial_index.load(reader, n) && region_index.load(reader, n) && reader.atEnd() &&
+                 lats.size() == n && lons.size() == n &&
+                 edge_v.size() == edge_u.size() && edge_weights.size() == edge_u.size() &&
+                 csr->offsets.size() == n + 1 && csr->offsets.front() == 0 &&
+                 csr->offsets.back() == csr->targets.size() && csr->weights.size() == csr->targets.size();
+    for (size_t i = 0; valid && i < n; ++i) {
+        valid = csr->offsets[i] <= csr->offsets[i + 1];
+    }
+    for (size_t k = 0; valid && k < csr->targets.size(); ++k) {
+        valid = csr->targets[k] >= 0 && static_cast<size_t>(csr->targets[k]) < n;
+    }
+    std::unordered_map<int, size_t> id_to_index;
+    id_to_index.reserve(n);
+    for (size_t i = 0; valid && i < n; ++i) {
+        valid = id_to_index.emplace(ids[i], i).second;
+    }
+    for (size_t i = 0; valid && i < edge_u.size(); ++i) {
+        valid = id_to_index.count(edge_u[i]) && id_to_index.count(edge_v[i]);
+    }
+    if (!valid) {
+        qWarning() << "GraphManager: Snapshot" << QString::fromStdString(filepath) << "is truncated or corrupt.";
+        return false;
+    }
+
+    // Nodes are stored in their Hilbert order and the indexes refer to it, so no reordering
+    nodes_.resize(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        nodes_[i] = Node(ids[i], lats[i], lons[i]);
+    }
+    node_id_to_index_map_ = std::move(id_to_index);
+    node_coords_to_id_map_.clear(); // Only needed while triangulating
+    load_errors_.clear();
+    load_error_count_ = 0;
+    resetNodeState();
+    spatial_index_ = std::move(spatial_index);
+    region_index_ = std::move(region_index);
+
+    std::vector<Edge> edges(edge_u.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < edge_u.size(); ++i) {
+        edges[i] = Edge(edge_u[i], edge_v[i], edge_weights[i]);
+    }
+    const size_t edge_count = edges.size();
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_.swap(edges);
+        base_adjacency_ = csr;
+        compressed_base_.reset();
+    }
+    edge_count_ = csr->targets.size() / 2;
+    if (low_memory_) compressBaseAdjacency();
+    edge_overrides_.clear();
+    applyEdgeOverrides();
+    graph_version_++;
+    resetObstacleLog();
+
+    qDebug() << "GraphManager: Loaded snapshot with" << n << "nodes and" << edge_count << "edges.";
+    emit graphUpdated();
+    return true;
+}
+
 void GraphManager::performTriangulation() {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
     qDebug() << "GraphManager: Performing Delaunay triangulation...";
-    edges_.clear();
-    for (auto& node : nodes_) {
-        node.neighbors.clear(); // Clear existing neighbors from previous runs
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_.clear();
+        adjacency_.reset();
+        compressed_adjacency_.reset();
     }
 
     if (nodes_.empty()) {
@@ -85,6 +454,8 @@ void GraphManager::performTriangulation() {
     }
 
     std::vector<cv::Point2f> cv_points;
+    node_coords_to_id_map_.clear();
+    node_coords_to_id_map_.reserve(nodes_.size());
     double min_lat = std::numeric_limits<double>::max();
     double max_lat = std::numeric_limits<double>::lowest();
     double min_lon = std::numeric_limits<double>::max();
@@ -93,6 +464,7 @@ void GraphManager::performTriangulation() {
     // Collect points and determine bounding box for Subdiv2D
     for (const auto& node : nodes_) {
         cv_points.emplace_back(static_cast<float>(node.coords.lon), static_cast<float>(node.coords.lat));
+        node_coords_to_id_map_[cv_points.back()] = node.id;
         min_lat = std::min(min_lat, node.coords.lat);
         max_lat = std::max(max_lat, node.coords.lat);
         min_lon = std::min(min_lon, node.coords.lon);
@@ -111,140 +483,819 @@ void GraphManager::performTriangulation() {
     std::vector<cv::Vec6f> triangleList;
     subdiv.getTriangleList(triangleList);
 
-    // Using a set to avoid duplicate edges (an edge might appear in multiple triangles)
-    std::unordered_set<std::pair<int, int>, std::hash<std::pair<int, int>>> unique_edges;
+    // Each thread collects the edges of its triangles locally (as canonical (min, max) dense index
+    // pairs); duplicates from neighboring triangles are removed after the merge.
+    std::vector<std::pair<int, int>> candidate_edges;
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int, int>> local_edges;
+        #pragma omp for nowait
+        for (size_t i = 0; i < triangleList.size(); ++i) {
+            cv::Vec6f t = triangleList[i];
+            cv::Point2f points[3] = { cv::Point2f(t[0], t[1]), cv::Point2f(t[2], t[3]), cv::Point2f(t[4], t[5]) };
 
-    // Parallelize processing of triangles to build edges
-    // Using a critical section for shared data (unique_edges, edges_, adj_list_)
-    #pragma omp parallel for
-    for (size_t i = 0; i < triangleList.size(); ++i) {
-        cv::Vec6f t = triangleList[i];
-        cv::Point2f p1(t[0], t[1]);
-        cv::Point2f p2(t[2], t[3]);
-        cv::Point2f p3(t[4], t[5]);
-
-        // Only process valid triangles (vertices should correspond to original points)
-        if (node_coords_to_id_map_.count(p1) &&
-            node_coords_to_id_map_.count(p2) &&
-            node_coords_to_id_map_.count(p3))
-        {
-            int id1 = node_coords_to_id_map_[p1];
-            int id2 = node_coords_to_id_map_[p2];
-            int id3 = node_coords_to_id_map_[p3];
-
-            // Helper to add edge if it doesn't already exist
-            auto add_edge_if_new = [&](int u, int v) {
-                if (u == v) return; // No self-loops
-                // Ensure canonical order for unique_edges set
-                int min_id = std::min(u, v);
-                int max_id = std::max(u, v);
-                if (unique_edges.find({min_id, max_id}) == unique_edges.end()) {
-                    #pragma omp critical
-                    {
-                        if (unique_edges.find({min_id, max_id}) == unique_edges.end()) { // Double check
-                            unique_edges.insert({min_id, max_id});
-                            const Node& node_u = getNode(u);
-                            const Node& node_v = getNode(v);
-                            double weight = haversineDistance(node_u.coords.lat, node_u.coords.lon,
-                                                              node_v.coords.lat, node_v.coords.lon);
-                            edges_.emplace_back(u, v, weight);
-
-                            // Add to adjacency list (index-based)
-                            nodes_[node_id_to_index_map_[u]].neighbors.push_back(v);
-                            nodes_[node_id_to_index_map_[v]].neighbors.push_back(u); // Undirected graph
-                        }
-                    }
-                }
-            };
+            // Only process valid triangles (vertices should correspond to original points)
+            int idx[3];
+            bool valid = true;
+            for (int k = 0; k < 3 && valid; ++k) {
+                auto it = node_coords_to_id_map_.find(points[k]);
+                valid = (it != node_coords_to_id_map_.end());
+                if (valid) idx[k] = static_cast<int>(node_id_to_index_map_.at(it->second));
+            }
+            if (!valid) continue;
 
-            add_edge_if_new(id1, id2);
-            add_edge_if_new(id2, id3);
-            add_edge_if_new(id3, id1);
+            for (int k = 0; k < 3; ++k) {
+                int u = idx[k];
+                int v = idx[(k + 1) % 3];
+                if (u == v) continue; // No self-loops
+                local_edges.emplace_back(std::min(u, v), std::max(u, v));
+            }
         }
+        #pragma omp critical(triangulation_edge_merge)
+        candidate_edges.insert(candidate_edges.end(), local_edges.begin(), local_edges.end());
+    }
+
+    std::sort(candidate_edges.begin(), candidate_edges.end());
+    candidate_edges.erase(std::unique(candidate_edges.begin(), candidate_edges.end()), candidate_edges.end());
+
+    std::vector<Edge> edges(candidate_edges.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < candidate_edges.size(); ++i) {
+        const Node& node_u = nodes_[candidate_edges[i].first];
+        const Node& node_v = nodes_[candidate_edges[i].second];
+        double weight = haversineDistance(node_u.coords.lat, node_u.coords.lon,
+                                          node_v.coords.lat, node_v.coords.lon);
+        edges[i] = Edge(node_u.id, node_v.id, weight);
     }
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_.swap(edges);
+    }
+
+    buildAdjacency();
+    graph_version_++;
+    resetObstacleLog();
 
-    qDebug() << "GraphManager: Triangulation complete. Found" << edges_.size() << "edges.";
+    qDebug() << "GraphManager: Triangulation complete. Found" << edge_count_ << "edges.";
     emit graphUpdated();
 }
 
+// Position of cell (x, y) along a Hilbert curve filling a 2^order x 2^order grid
+static uint64_t hilbertIndex(uint32_t x, uint32_t y, int order) {
+    uint64_t d = 0;
+    for (uint32_t s = 1u << (order - 1); s > 0; s >>= 1) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the sub-curve connects to its neighbors
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return d;
+}
+
+void GraphManager::reorderNodesAlongHilbertCurve() {
+    const size_t n = nodes_.size();
+    if (n < 2) return;
+
+    double min_lat = nodes_[0].coords.lat, max_lat = min_lat;
+    double min_lon = nodes_[0].coords.lon, max_lon = min_lon;
+    for (const auto& node : nodes_) {
+        min_lat = std::min(min_lat, node.coords.lat);
+        max_lat = std::max(max_lat, node.coords.lat);
+        min_lon = std::min(min_lon, node.coords.lon);
+        max_lon = std::max(max_lon, node.coords.lon);
+    }
+
+    // Quantize to a 2^16 x 2^16 grid over the bounding box; nodes that share a cell keep
+    // their file order (stable sort), which keeps the result deterministic
+    const int order = 16;
+    const double cells = static_cast<double>((1u << order) - 1);
+    const double lat_scale = max_lat > min_lat ? cells / (max_lat - min_lat) : 0.0;
+    const double lon_scale = max_lon > min_lon ? cells / (max_lon - min_lon) : 0.0;
+    std::vector<std::pair<uint64_t, size_t>> keys(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t x = static_cast<uint32_t>((nodes_[i].coords.lon - min_lon) * lon_scale);
+        uint32_t y = static_cast<uint32_t>((nodes_[i].coords.lat - min_lat) * lat_scale);
+        keys[i] = { hilbertIndex(x, y, order), i };
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const std::pair<uint64_t, size_t>& a, const std::pair<uint64_t, size_t>& b) { return a.first < b.first; });
+
+    std::vector<Node> reordered(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        reordered[i] = nodes_[keys[i].second];
+    }
+    nodes_.swap(reordered);
+
+    // External IDs stay stable; only their dense indices change
+    node_id_to_index_map_.clear();
+    node_id_to_index_map_.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        node_id_to_index_map_[nodes_[i].id] = i;
+    }
+    qDebug() << "GraphManager: Reordered" << n << "nodes along a Hilbert curve.";
+}
+
 int GraphManager::getClosestNodeId(double lat, double lon) const {
     if (nodes_.empty()) return -1; // No nodes to search
 
-    int closestId = -1;
-    double minDistance = std::numeric_limits<double>::max();
+    double distance = 0.0;
+    int index = spatial_index_.nearest(lat, lon, &distance);
+    if (index < 0) return -1;
+    int closestId = nodes_[index].id;
+
+    qDebug() << "GraphManager: Closest node to (" << lat << "," << lon << ") is ID" << closestId
+             << "with distance" << distance << "km.";
+    return closestId;
+}
+
+SnapResult GraphManager::snapToNodes(const std::vector<double>& lats, const std::vector<double>& lons) const {
+    SnapResult result;
+    if (lats.size() != lons.size()) {
+        qWarning() << "GraphManager: snapToNodes got" << lats.size() << "latitudes but" << lons.size() << "longitudes.";
+        return result;
+    }
+    const size_t count = lats.size();
+    result.node_ids.resize(count);
+    result.distances_km.resize(count);
+    spatial_index_.nearestBatch(lats.data(), lons.data(), count, result.node_ids.data(), result.distances_km.data());
 
-    // Use OpenMP for parallel search of closest node
-    // Note: Reduction for minDistance and closestId needs careful handling or
-    // a custom reduction, or simply run sequentially for this relatively small loop.
-    // For 1M nodes, a k-d tree or similar spatial index is much better.
-    // For simplicity of this example, we'll use a sequential brute force.
+    // Dense indices to node IDs
+    #pragma omp parallel for
+    for (size_t i = 0; i < count; ++i) {
+        int index = result.node_ids[i];
+        result.node_ids[i] = index >= 0 ? nodes_[index].id : -1;
+    }
+    qDebug() << "GraphManager: Snapped" << count << "points to nodes.";
+    return result;
+}
 
-    // A simple sequential scan is easier and often fast enough for this specific task
-    // unless you call it thousands of times per second.
-    for (const auto& node : nodes_) {
-        double dist = haversineDistance(lat, lon, node.coords.lat, node.coords.lon);
-        if (dist < minDistance) {
-            minDistance = dist;
-            closestId = node.id;
+std::vector<int> GraphManager::getClosestNodeIds(double lat, double lon, size_t k) const {
+    std::vector<int> ids;
+    for (const auto& entry : spatial_index_.kNearest(lat, lon, k)) {
+        ids.push_back(nodes_[entry.first].id);
+    }
+    return ids;
+}
+
+ViewportGraph GraphManager::getViewportGraph(double minLat, double minLon, double maxLat, double maxLon, size_t maxNodes) const {
+    ViewportGraph view;
+    const PackedRTree::Box box = { minLat, minLon, maxLat, maxLon };
+    std::vector<int> hits = region_index_.query(box);
+    std::sort(hits.begin(), hits.end()); // Stable output while panning
+    std::shared_ptr<const CsrAdjacency> graph = getAdjacency();
+    std::shared_ptr<const CompressedAdjacency> compressed = getCompressedAdjacency(); // Low-memory mode
+    const bool has_edges = graph || compressed;
+    auto forEachNeighbor = [&](int u, const auto& f) {
+        if (graph) graph->forEachNeighbor(u, f);
+        else compressed->forEachNeighbor(u, f);
+    };
+    auto inView = [&](int i) { return box.contains(nodes_[i].coords.lat, nodes_[i].coords.lon); };
+
+    if (hits.size() <= std::max<size_t>(maxNodes, 1)) {
+        view.node_indices = std::move(hits);
+        if (has_edges) {
+            // Each edge once: from its smaller end if both ends are in view, else from the one that is
+            for (int u : view.node_indices) {
+                forEachNeighbor(u, [&](int v, double) {
+                    if (u < v || !inView(v)) view.edges.push_back({ u, v });
+                });
+            }
         }
+        return view;
     }
 
-    qDebug() << "GraphManager: Closest node to (" << lat << "," << lon << ") is ID" << closestId
-             << "with distance" << minDistance << "km.";
-    return closestId;
+    // Level of detail: a grid of roughly square cells (on screen), about maxNodes in total
+    view.decimated = true;
+    const double lat_span = std::max(maxLat - minLat, 1e-9);
+    const double lon_span = std::max(maxLon - minLon, 1e-9);
+    const double aspect = lon_span * std::cos((minLat + maxLat) * 0.5 * M_PI / 180.0) / lat_span;
+    const int cols = std::max(1, static_cast<int>(std::sqrt(maxNodes * aspect)));
+    const int rows = std::max(1, static_cast<int>(maxNodes / cols));
+    auto cellOf = [&](int i) {
+        int row = std::min(rows - 1, static_cast<int>((nodes_[i].coords.lat - minLat) / lat_span * rows));
+        int col = std::min(cols - 1, static_cast<int>((nodes_[i].coords.lon - minLon) / lon_span * cols));
+        return row * cols + col;
+    };
+
+    std::vector<int> representative(static_cast<size_t>(rows) * cols, -1);
+    for (int i : hits) {
+        int& rep = representative[cellOf(i)];
+        if (rep < 0 || (!obstacles_.test(rep) && obstacles_.test(i))) rep = i; // Keep blocked areas visible
+    }
+    for (int rep : representative) {
+        if (rep >= 0) view.node_indices.push_back(rep);
+    }
+
+    if (has_edges) {
+        std::unordered_set<uint64_t> cell_edges;
+        for (int u : hits) {
+            int cu = cellOf(u);
+            forEachNeighbor(u, [&](int v, double) {
+                if (!inView(v)) return;
+                int cv = cellOf(v);
+                if (cu < cv && cell_edges.insert((static_cast<uint64_t>(cu) << 32) | static_cast<uint32_t>(cv)).second) {
+                    view.edges.push_back({ representative[cu], representative[cv] });
+                }
+            });
+        }
+    }
+    qDebug() << "GraphManager: Viewport holds" << hits.size() << "nodes, decimated to"
+             << view.node_indices.size() << "cells.";
+    return view;
 }
 
 void GraphManager::toggleObstacleNode(int nodeId) {
-    auto it = node_id_to_index_map_.find(nodeId);
-    if (it != node_id_to_index_map_.end()) {
-        size_t index = it->second;
-        nodes_[index].is_obstacle = !nodes_[index].is_obstacle; // Toggle status
-        if (nodes_[index].is_obstacle) {
-            obstacle_node_ids_.insert(nodeId);
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        auto it = node_id_to_index_map_.find(nodeId);
+        if (it == node_id_to_index_map_.end()) {
+            qWarning() << "GraphManager: Node ID" << nodeId << "not found.";
+            return;
+        }
+        int index = static_cast<int>(it->second);
+        if (!obstacles_.test(index)) { // Toggle status
+            manual_obstacles_.set(index);
             qDebug() << "GraphManager: Node" << nodeId << "set as obstacle.";
         } else {
-            obstacle_node_ids_.erase(nodeId);
-            qDebug() << "GraphManager: Node" << nodeId << "cleared as obstacle.";
+            manual_obstacles_.reset(index);
+            if (shape_refcount_[index] > 0) {
+                qDebug() << "GraphManager: Node" << nodeId << "stays an obstacle, it lies inside"
+                         << shape_refcount_[index] << "obstacle shapes.";
+            } else {
+                qDebug() << "GraphManager: Node" << nodeId << "cleared as obstacle.";
+            }
         }
-        emit graphUpdated();
-    } else {
-        qWarning() << "GraphManager: Node ID" << nodeId << "not found.";
+        refreshObstacles({ index });
     }
+    emit graphUpdated(); // After unlocking: handlers connected directly read the obstacle set
+}
+
+int GraphManager::refreshObstacles(const std::vector<int>& indices) {
+    std::vector<int> changed;
+    for (int index : indices) {
+        bool blocked = manual_obstacles_.test(index) || shape_refcount_[index] > 0;
+        if (blocked ? obstacles_.set(index) : obstacles_.reset(index)) {
+            changed.push_back(index);
+        }
+    }
+    if (!changed.empty()) {
+        graph_version_++; // Edits that leave every node as it was keep cached routes valid
+        logObstacleChanges(changed);
+    }
+    return static_cast<int>(changed.size());
+}
+
+void GraphManager::logObstacleChanges(const std::vector<int>& indices) {
+    std::lock_guard<std::mutex> lock(obstacle_log_mutex_);
+    if (obstacle_log_.size() + indices.size() > kMaxObstacleLogSize) {
+        // Readers that are this far behind recompute from scratch anyway
+        obstacle_log_.clear();
+        obstacle_log_base_ = graph_version_.load();
+        return;
+    }
+    uint64_t version = graph_version_.load();
+    for (int index : indices) {
+        obstacle_log_.push_back({ version, index });
+    }
+}
+
+void GraphManager::resetObstacleLog() {
+    std::lock_guard<std::mutex> lock(obstacle_log_mutex_);
+    obstacle_log_.clear();
+    obstacle_log_base_ = graph_version_.load();
+}
+
+bool GraphManager::getObstacleChangesSince(uint64_t since, std::vector<int>& changed) const {
+    std::lock_guard<std::mutex> lock(obstacle_log_mutex_);
+    if (since < obstacle_log_base_) {
+        return false;
+    }
+    // Entries are appended in version order
+    auto first = std::upper_bound(obstacle_log_.begin(), obstacle_log_.end(), since,
+                                  [](uint64_t v, const ObstacleChange& change) { return v < change.version; });
+    for (auto it = first; it != obstacle_log_.end(); ++it) {
+        changed.push_back(it->index);
+    }
+    return true;
+}
+
+int GraphManager::blockNodes(const std::vector<int>& indices) {
+    int count = 0;
+    for (int index : indices) {
+        if (manual_obstacles_.set(index) && !obstacles_.test(index)) { // Only counts nodes that were not already obstacles
+            count++;
+        }
+    }
+    refreshObstacles(indices);
+    return count;
 }
 
 void GraphManager::setObstacleArea(double minLat, double minLon, double maxLat, double maxLon) {
     qDebug() << "GraphManager: Setting obstacle area from (" << minLat << "," << minLon << ") to (" << maxLat << "," << maxLon << ")";
-    int count = 0;
-    #pragma omp parallel for reduction(+:count) // Parallelize the loop over nodes
-    for (size_t i = 0; i < nodes_.size(); ++i) {
-        Node& node = nodes_[i]; // Reference to modify directly
-        if (node.coords.lat >= minLat && node.coords.lat <= maxLat &&
-            node.coords.lon >= minLon && node.coords.lon <= maxLon)
-        {
-            if (!node.is_obstacle) { // Only change if not already an obstacle
-                node.is_obstacle = true;
-                #pragma omp critical(obstacle_set_update) // Protect access to shared set
-                {
-                    obstacle_node_ids_.insert(node.id);
-                }
-                count++;
+    int count;
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        count = blockNodes(region_index_.query({ minLat, minLon, maxLat, maxLon }));
+    }
+    qDebug() << "GraphManager: Set" << count << "nodes as obstacles in the area.";
+    emit graphUpdated();
+}
+
+// Crossing-number test of the points (lats[i], lons[i]) against all rings, flipping inside[i]
+// for every ring edge a horizontal ray from the point crosses. The loop runs edge by edge over
+// all points, so the inner loop is branch-free and vectorizes.
+static void pointsInRings(const std::vector<std::vector<LatLon>>& rings, const double* lats, const double* lons,
+                          size_t count, unsigned char* inside) {
+    for (const auto& ring : rings) {
+        const size_t m = ring.size();
+        for (size_t e = 0; e < m; ++e) {
+            const double ay = ring[e].lat, ax = ring[e].lon;
+            const double by = ring[(e + 1) % m].lat, bx = ring[(e + 1) % m].lon;
+            const bool upward = by > ay;
+            #pragma omp simd
+            for (size_t i = 0; i < count; ++i) {
+                const double py = lats[i], px = lons[i];
+                const bool straddles = (ay > py) != (by > py);
+                // Sign of (px - x_cross) * (by - ay), avoiding the division
+                const double side = (px - ax) * (by - ay) - (py - ay) * (bx - ax);
+                inside[i] ^= static_cast<unsigned char>(straddles && ((side < 0) == upward));
             }
         }
     }
-    qDebug() << "GraphManager: Set" << count << "nodes as obstacles in the area.";
+}
+
+std::vector<int> GraphManager::nodesInPolygon(const std::vector<std::vector<LatLon>>& rings) const {
+    std::vector<int> hits;
+    PackedRTree::Box bounds = { std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                                -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+    size_t vertex_count = 0;
+    for (const auto& ring : rings) {
+        if (ring.size() < 3) continue;
+        vertex_count += ring.size();
+        for (const auto& vertex : ring) {
+            bounds.min_lat = std::min(bounds.min_lat, vertex.lat);
+            bounds.min_lon = std::min(bounds.min_lon, vertex.lon);
+            bounds.max_lat = std::max(bounds.max_lat, vertex.lat);
+            bounds.max_lon = std::max(bounds.max_lon, vertex.lon);
+        }
+    }
+    if (vertex_count == 0) {
+        qWarning() << "GraphManager: Obstacle polygon has no ring with at least 3 vertices.";
+        return hits;
+    }
+
+    // Bounding box candidates from the R-tree, then the exact test on a contiguous copy
+    std::vector<int> candidates = region_index_.query(bounds);
+    const size_t n = candidates.size();
+    std::vector<double> lats(n), lons(n);
+    std::vector<unsigned char> inside(n, 0);
+    const double* all_lats = coordinates_.lats();
+    const double* all_lons = coordinates_.lons();
+    for (size_t i = 0; i < n; ++i) {
+        lats[i] = all_lats[candidates[i]];
+        lons[i] = all_lons[candidates[i]];
+    }
+    const size_t chunk = 4096; // Candidates per task; small polygons stay on one thread
+    #pragma omp parallel for schedule(dynamic, 1) if (n > chunk)
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        size_t len = std::min(chunk, n - begin);
+        pointsInRings(rings, lats.data() + begin, lons.data() + begin, len, inside.data() + begin);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (inside[i]) hits.push_back(candidates[i]);
+    }
+    qDebug() << "GraphManager: Polygon with" << vertex_count << "vertices contains" << hits.size()
+             << "nodes (" << n << "candidates).";
+    return hits;
+}
+
+std::vector<int> GraphManager::nodesInCircle(const LatLon& center, double radiusKm) const {
+    // Latitude/longitude box enclosing the circle (longitude span grows towards the poles)
+    const double R = 6371.0;
+    double dLat = radiusKm / R * 180.0 / M_PI;
+    double cosLat = std::cos(center.lat * M_PI / 180.0);
+    double dLon = cosLat > 1e-9 ? std::min(180.0, dLat / cosLat) : 180.0;
+    std::vector<int> candidates = region_index_.query({ center.lat - dLat, center.lon - dLon,
+                                                        center.lat + dLat, center.lon + dLon });
+
+    std::vector<double> distances(candidates.size());
+    coordinates_.distancesKm(center.lat, center.lon, candidates.data(), candidates.size(), distances.data());
+    std::vector<int> hits;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (distances[i] <= radiusKm) hits.push_back(candidates[i]);
+    }
+    return hits;
+}
+
+std::vector<int> GraphManager::nodesInShape(const ObstacleShape& shape) const {
+    std::vector<int> hits;
+    switch (shape.type) {
+        case ObstacleShape::Type::Polygon:
+            hits = nodesInPolygon(shape.rings);
+            break;
+        case ObstacleShape::Type::Circle:
+            hits = nodesInCircle(shape.center, shape.radius_km);
+            break;
+        case ObstacleShape::Type::Point: {
+            int index = spatial_index_.nearest(shape.center.lat, shape.center.lon);
+            if (index >= 0) hits.push_back(index);
+            break;
+        }
+    }
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+int GraphManager::setObstaclePolygon(const std::vector<std::vector<LatLon>>& rings) {
+    int count;
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        count = blockNodes(nodesInPolygon(rings));
+    }
+    qDebug() << "GraphManager: Set" << count << "nodes as obstacles in the polygon.";
+    emit graphUpdated();
+    return count;
+}
+
+int GraphManager::setObstacleCircle(const LatLon& center, double radiusKm) {
+    qDebug() << "GraphManager: Setting obstacle circle at (" << center.lat << "," << center.lon << ") radius" << radiusKm << "km";
+    int count;
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        count = blockNodes(nodesInCircle(center, radiusKm));
+    }
+    qDebug() << "GraphManager: Set" << count << "nodes as obstacles in the circle.";
     emit graphUpdated();
+    return count;
+}
+
+int GraphManager::setObstacleShape(int shapeId, const ObstacleShape& shape) {
+    size_t covered_count;
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        std::vector<int> covered = nodesInShape(shape);
+        std::vector<int>& previous = obstacle_shapes_[shapeId]; // Empty for a new shape
+
+        // Only nodes that enter or leave the shape change their reference count
+        std::vector<int> entered, left;
+        std::set_difference(covered.begin(), covered.end(), previous.begin(), previous.end(), std::back_inserter(entered));
+        std::set_difference(previous.begin(), previous.end(), covered.begin(), covered.end(), std::back_inserter(left));
+        for (int index : entered) shape_refcount_[index]++;
+        for (int index : left) shape_refcount_[index]--;
+        previous.swap(covered);
+        covered_count = previous.size();
+
+        std::vector<int> touched(entered);
+        touched.insert(touched.end(), left.begin(), left.end());
+        int changed = refreshObstacles(touched);
+        qDebug() << "GraphManager: Obstacle shape" << shapeId << "covers" << covered_count << "nodes ("
+                 << entered.size() << "added," << left.size() << "removed," << changed << "obstacle changes).";
+    }
+    emit graphUpdated();
+    return static_cast<int>(covered_count);
+}
+
+bool GraphManager::removeObstacleShape(int shapeId) {
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        auto it = obstacle_shapes_.find(shapeId);
+        if (it == obstacle_shapes_.end()) {
+            qWarning() << "GraphManager: Obstacle shape" << shapeId << "not found.";
+            return false;
+        }
+        for (int index : it->second) shape_refcount_[index]--;
+        int changed = refreshObstacles(it->second);
+        qDebug() << "GraphManager: Removed obstacle shape" << shapeId << "," << changed << "nodes cleared.";
+        obstacle_shapes_.erase(it);
+    }
+    emit graphUpdated();
+    return true;
+}
+
+std::vector<int> GraphManager::getObstacleShapeIds() const {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+    std::vector<int> ids;
+    ids.reserve(obstacle_shapes_.size());
+    for (const auto& entry : obstacle_shapes_) ids.push_back(entry.first);
+    std::sort(ids.begin(), ids.end());
+    return ids;
 }
 
 void GraphManager::clearAllObstacles() {
     qDebug() << "GraphManager: Clearing all obstacles.";
+    {
+        std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+        bool had_obstacles = !obstacles_.empty();
+        // Reference counts are only nonzero on nodes covered by a shape
+        for (const auto& entry : obstacle_shapes_) {
+            for (int index : entry.second) shape_refcount_[index] = 0;
+        }
+        obstacle_shapes_.clear();
+        std::vector<int> cleared = obstacles_.indices();
+        manual_obstacles_.clear(); // O(1): bumps the bitset epoch
+        obstacles_.clear();
+        if (had_obstacles) {
+            graph_version_++;
+            logObstacleChanges(cleared);
+        }
+    }
+    emit graphUpdated();
+}
+
+void GraphManager::buildAdjacency() {
+    auto csr = std::make_shared<CsrAdjacency>();
+    const size_t n = nodes_.size();
+    csr->offsets.assign(n + 1, 0);
+
+    // Resolve edge endpoints to dense indices once
+    std::vector<std::pair<int, int>> endpoints(edges_.size());
     #pragma omp parallel for
-    for (size_t i = 0; i < nodes_.size(); ++i) {
-        nodes_[i].is_obstacle = false; // Reset flag
+    for (size_t i = 0; i < edges_.size(); ++i) {
+        endpoints[i] = { getNodeIndex(edges_[i].u_id), getNodeIndex(edges_[i].v_id) };
+    }
+
+    // Count degrees (undirected graph: every edge appears in both rows)
+    for (const auto& e : endpoints) {
+        if (e.first < 0 || e.second < 0) continue;
+        csr->offsets[e.first + 1]++;
+        csr->offsets[e.second + 1]++;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        csr->offsets[i + 1] += csr->offsets[i];
+    }
+
+    csr->targets.resize(csr->offsets[n]);
+    csr->weights.resize(csr->offsets[n]);
+    std::vector<size_t> cursor(csr->offsets.begin(), csr->offsets.end() - 1);
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        int u = endpoints[i].first;
+        int v = endpoints[i].second;
+        if (u < 0 || v < 0) continue;
+        csr->targets[cursor[u]] = v;
+        csr->weights[cursor[u]++] = edges_[i].weight;
+        csr->targets[cursor[v]] = u;
+        csr->weights[cursor[v]++] = edges_[i].weight;
+    }
+
+    // Sort each row by target so neighbor scans walk memory in index order
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < n; ++i) {
+        size_t begin = csr->offsets[i];
+        size_t end = csr->offsets[i + 1];
+        std::vector<std::pair<int, double>> row;
+        row.reserve(end - begin);
+        for (size_t k = begin; k < end; ++k) row.emplace_back(csr->targets[k], csr->weights[k]);
+        std::sort(row.begin(), row.end());
+        for (size_t k = begin; k < end; ++k) {
+            csr->targets[k] = row[k - begin].first;
+            csr->weights[k] = row[k - begin].second;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        base_adjacency_ = csr;
+        compressed_base_.reset();
+    }
+    edge_count_ = csr->targets.size() / 2;
+    qDebug() << "GraphManager: Built CSR adjacency with" << csr->targets.size() << "directed arcs.";
+    if (low_memory_) compressBaseAdjacency();
+    applyEdgeOverrides();
+}
+
+void GraphManager::compressBaseAdjacency() {
+    if (!base_adjacency_) return;
+    std::shared_ptr<const CompressedAdjacency> compressed = CompressedAdjacency::build(*base_adjacency_);
+    if (!compressed) return; // Keeps the CSR arrays
+    std::vector<Edge> released; // Freed after the lock; edgesFromAdjacency() recreates them when needed
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    compressed_base_ = compressed;
+    base_adjacency_.reset();
+    released.swap(edges_);
+    // adjacency_ stays until the caller's applyEdgeOverrides() replaces it, so searches never
+    // see neither adjacency
+}
+
+std::vector<Edge> GraphManager::edgesFromAdjacency(const CsrAdjacency& csr) const {
+    std::vector<Edge> edges;
+    edges.reserve(csr.targets.size() / 2);
+    for (size_t u = 0; u < csr.nodeCount(); ++u) {
+        for (size_t k = csr.edgeBegin(static_cast<int>(u)); k < csr.edgeEnd(static_cast<int>(u)); ++k) {
+            size_t v = static_cast<size_t>(csr.targets[k]);
+            if (u < v) edges.emplace_back(nodes_[u].id, nodes_[v].id, csr.weights[k]);
+        }
     }
-    obstacle_node_ids_.clear(); // Clear the set
+    return edges;
+}
+
+void GraphManager::setLowMemoryMode(bool enabled) {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_);
+    if (enabled == low_memory_) return;
+    low_memory_ = enabled;
+    if (enabled) {
+        compressBaseAdjacency();
+    } else if (compressed_base_) {
+        auto csr = std::make_shared<CsrAdjacency>(compressed_base_->toCsr());
+        std::vector<Edge> edges = edgesFromAdjacency(*csr);
+        std::lock_guard<std::mutex> lock(adjacency_mutex_);
+        edges_.swap(edges);
+        base_adjacency_ = csr;
+        compressed_base_.reset();
+    }
+    if (!base_adjacency_ && !compressed_base_) return; // Applies to the next graph
+
+    applyEdgeOverrides();
+    graph_version_++;
+    resetObstacleLog(); // Weights may have been rounded
+    qDebug() << "GraphManager: Low-memory adjacency" << (enabled ? "enabled." : "disabled.");
     emit graphUpdated();
 }
 
+bool GraphManager::hasBaseArc(int u, int v) const {
+    if (compressed_base_) return compressed_base_->hasArc(u, v);
+    if (!base_adjacency_) return false;
+    const auto& targets = base_adjacency_->targets;
+    return std::binary_search(targets.begin() + base_adjacency_->edgeBegin(u),
+                              targets.begin() + base_adjacency_->edgeEnd(u), v);
+}
+
+uint64_t GraphManager::edgeKey(int u, int v) const {
+    uint32_t a = static_cast<uint32_t>(std::min(u, v));
+    uint32_t b = static_cast<uint32_t>(std::max(u, v));
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+std::vector<Edge> GraphManager::getAllEdges() const {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    return edges_;
+}
+
+std::shared_ptr<const CsrAdjacency> GraphManager::getAdjacency() const {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    return adjacency_;
+}
+
+std::shared_ptr<const CsrAdjacency> GraphManager::getBaseAdjacency() const {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    return base_adjacency_;
+}
+
+std::shared_ptr<const CompressedAdjacency> GraphManager::getCompressedAdjacency() const {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    return compressed_adjacency_;
+}
+
+bool GraphManager::hasAdjacency() const {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    return adjacency_ || compressed_adjacency_;
+}
+
+void GraphManager::publishAdjacency(std::shared_ptr<const CsrAdjacency> adjacency,
+                                    std::shared_ptr<const CompressedAdjacency> compressed) {
+    std::lock_guard<std::mutex> lock(adjacency_mutex_);
+    adjacency_ = std::move(adjacency);
+    compressed_adjacency_ = std::move(compressed);
+}
+
+void GraphManager::applyEdgeOverrides() {
+    if (compressed_base_) {
+        if (edge_overrides_.empty()) {
+            publishAdjacency(nullptr, compressed_base_);
+            return;
+        }
+        // Re-encoded from the base one row at a time, so the CSR arrays never exist in full
+        std::shared_ptr<const CompressedAdjacency> base = compressed_base_;
+        publishAdjacency(nullptr, CompressedAdjacency::build(base->nodeCount(),
+            [this, &base](int index, std::vector<std::pair<int, double>>& row) {
+                base->decodeRow(index, row);
+                for (auto& arc : row) {
+                    auto it = edge_overrides_.find(edgeKey(index, arc.first));
+                    if (it != edge_overrides_.end()) {
+                        arc.second = std::isinf(it->second) ? it->second : arc.second * it->second;
+                    }
+                }
+            }));
+        return;
+    }
+    if (!base_adjacency_ || edge_overrides_.empty()) {
+        publishAdjacency(base_adjacency_, nullptr); // Same snapshot, so the contraction hierarchy stays usable
+        return;
+    }
+
+    // New snapshot: searches still holding the previous one are unaffected
+    auto csr = std::make_shared<CsrAdjacency>(*base_adjacency_);
+    for (const auto& entry : edge_overrides_) {
+        int u = static_cast<int>(entry.first >> 32);
+        int v = static_cast<int>(entry.first & 0xffffffffu);
+        for (int k = 0; k < 2; ++k) {
+            int from = k == 0 ? u : v;
+            int to = k == 0 ? v : u;
+            auto begin = csr->targets.begin() + csr->edgeBegin(from);
+            auto end = csr->targets.begin() + csr->edgeEnd(from);
+            auto it = std::lower_bound(begin, end, to); // Rows are sorted by target
+            if (it != end && *it == to) {
+                double& weight = csr->weights[it - csr->targets.begin()];
+                weight = std::isinf(entry.second) ? entry.second : weight * entry.second; // 0 * inf is NaN
+            }
+        }
+    }
+    publishAdjacency(csr, nullptr);
+}
+
+bool GraphManager::setEdgeOverride(int uId, int vId, double multiplier) {
+    std::unique_lock<std::mutex> update_lock(graph_update_mutex_);
+    int u = getNodeIndex(uId);
+    int v = getNodeIndex(vId);
+    if (u < 0 || v < 0 || (!base_adjacency_ && !compressed_base_)) return false;
+    if (!hasBaseArc(u, v)) {
+        qWarning() << "GraphManager: No edge between nodes" << uId << "and" << vId;
+        return false;
+    }
+
+    uint64_t key = edgeKey(u, v);
+    auto it = edge_overrides_.find(key);
+    if (multiplier == 1.0) {
+        if (it == edge_overrides_.end()) return true; // Nothing to clear
+        edge_overrides_.erase(it);
+    } else {
+        if (it != edge_overrides_.end() && it->second == multiplier) return true; // Unchanged
+        edge_overrides_[key] = multiplier;
+    }
+
+    applyEdgeOverrides();
+    graph_version_++;
+    resetObstacleLog(); // Weight changes are not in the obstacle log
+    update_lock.unlock(); // Handlers connected directly may call back into the locked getters
+    emit graphUpdated();
+    return true;
+}
+
+bool GraphManager::setEdgePenalty(int uId, int vId, double multiplier) {
+    if (!(multiplier >= 1.0) || std::isinf(multiplier)) {
+        qWarning() << "GraphManager: Edge penalty must be a finite multiplier >= 1, got" << multiplier;
+        return false;
+    }
+    qDebug() << "GraphManager: Edge" << uId << "-" << vId << "penalty set to" << multiplier;
+    return setEdgeOverride(uId, vId, multiplier);
+}
+
+bool GraphManager::closeEdge(int uId, int vId) {
+    qDebug() << "GraphManager: Closing edge" << uId << "-" << vId;
+    return setEdgeOverride(uId, vId, std::numeric_limits<double>::infinity());
+}
+
+bool GraphManager::clearEdgeOverride(int uId, int vId) {
+    return setEdgeOverride(uId, vId, 1.0);
+}
+
+void GraphManager::clearAllEdgeOverrides() {
+    std::unique_lock<std::mutex> update_lock(graph_update_mutex_);
+    if (edge_overrides_.empty()) return;
+    qDebug() << "GraphManager: Clearing" << edge_overrides_.size() << "edge overrides.";
+    edge_overrides_.clear();
+    applyEdgeOverrides();
+    graph_version_++;
+    resetObstacleLog(); // Weight changes are not in the obstacle log
+    update_lock.unlock();
+    emit graphUpdated();
+}
+
+int GraphManager::getNodeIndex(int nodeId) const {
+    auto it = node_id_to_index_map_.find(nodeId);
+    return it != node_id_to_index_map_.end() ? static_cast<int>(it->second) : -1;
+}
+
+bool GraphManager::isObstacle(int nodeId) const {
+    int index = getNodeIndex(nodeId);
+    return index >= 0 && obstacles_.test(index);
+}
+
+std::vector<int> GraphManager::getObstacleNodeIds() const {
+    std::vector<int> ids = obstacles_.indices();
+    for (int& id : ids) {
+        id = nodes_[id].id; // Dense index to node ID, in place
+    }
+    return ids;
+}
+
+void GraphManager::copyNodeState(CoordinateArrays& coordinates, ObstacleBitset& obstacles) const {
+    std::lock_guard<std::mutex> update_lock(graph_update_mutex_); // Held by resetNodeState() callers
+    coordinates = coordinates_;
+    obstacles = obstacles_;
+}
+
 Node GraphManager::getNode(int nodeId) const {
     auto it = node_id_to_index_map_.find(nodeId);
     if (it != node_id_to_index_map_.end()) {
@@ -3,13 +3,22 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
 #include <unordered_map>
-#include <unordered_set>
 #include <QDebug> // For debugging purposes within the class
 #include <opencv2/core.hpp> // For OpenCV data types (Point2f, Rect)
 #include <opencv2/imgproc.hpp> // For cv::Subdiv2D
 
 #include "data_types.h" // Your common data types
+#include "spatial_index.h"
+#include "packed_rtree.h"
+#include "obstacle_bitset.h"
+#include "coordinate_arrays.h"
+#include "compressed_adjacency.h"
 
 // A custom hash for LatLon if you need to use it in unordered_map/set keys
 // For Node, Edge, etc.
@@ -21,6 +30,28 @@ namespace std {
     };
 }
 
+// Result of GraphManager::snapToNodes, parallel to the input arrays
+struct SnapResult {
+    std::vector<int> node_ids;        // Closest node ID per point, -1 if there are no nodes
+    std::vector<double> distances_km; // Great-circle distance to that node
+};
+
+// Result of GraphManager::getViewportGraph, in dense node indices
+struct ViewportGraph {
+    std::vector<int> node_indices;          // Nodes to draw
+    std::vector<std::pair<int, int>> edges; // Segments to draw between two nodes
+    bool decimated = false;                 // Nodes stand for grid cells (level of detail)
+};
+
+// Geometry of a registered obstacle shape (see GraphManager::setObstacleShape)
+struct ObstacleShape {
+    enum class Type { Polygon, Circle, Point };
+    Type type = Type::Polygon;
+    std::vector<std::vector<LatLon>> rings; // Polygon: rings as in setObstaclePolygon
+    LatLon center;                          // Circle center, or Point (blocks the closest node)
+    double radius_km = 0.0;                 // Circle
+};
+
 class GraphManager : public QObject { // Inherit from QObject for signals/slots if needed later
     Q_OBJECT // Add Q_OBJECT if you want this class to use signals/slots itself.
 
@@ -30,20 +61,105 @@ public:
     }
 
     // Core operations
-    bool loadNodesFromFile(const std::string& filepath);
+    // Called by loadNodesFromFile on the loading thread after each parsed batch, with the nodes
+    // of that batch (in file order) and the number of bytes of the file read so far
+    using LoadProgressCallback = std::function<void(const std::vector<Node>& batch, size_t bytesDone, size_t bytesTotal)>;
+    // Loads "id,lat,lon" rows after a header line. The file is memory-mapped and parsed in
+    // parallel chunks; malformed rows are skipped and reported with their line numbers.
+    // With a progress callback the nodes are streamed to it batch by batch while loading.
+    bool loadNodesFromFile(const std::string& filepath, const LoadProgressCallback& progress = nullptr);
+    const std::vector<std::string>& getLoadErrors() const { return load_errors_; } // First kMaxReportedLoadErrors
+    size_t getLoadErrorCount() const { return load_error_count_; } // All malformed rows of the last load
     void performTriangulation(); // Generates edges using OpenCV
+    // Alternative to the two calls above: nodes and edges from the streets of an OpenStreetMap
+    // extract (.osm or .osm.pbf, see osm_importer.h). Node IDs are assigned sequentially.
+    bool loadOsmFile(const std::string& filepath);
+    // Binary snapshot of the triangulated graph (nodes, edges, base adjacency and spatial
+    // indexes; see graph_snapshot.h). Loading one replaces loadNodesFromFile() plus
+    // performTriangulation(); obstacles and edge overrides are not stored. saveSnapshot() returns
+    // false in low-memory mode, whose weights are rounded. loadSnapshot() returns false and keeps
+    // the current graph if the file is missing, from another format version or corrupt.
+    bool saveSnapshot(const std::string& filepath) const;
+    bool loadSnapshot(const std::string& filepath);
     int getClosestNodeId(double lat, double lon) const; // Finds graph node from map click
+    std::vector<int> getClosestNodeIds(double lat, double lon, size_t k) const; // k closest, closest first
+    // Batch version of getClosestNodeId for bulk GPS snapping (parallel, no per-point logging)
+    SnapResult snapToNodes(const std::vector<double>& lats, const std::vector<double>& lons) const;
+    // Nodes inside a map viewport and the edges touching them. With more than 'maxNodes' nodes
+    // inside, the viewport is cut into about 'maxNodes' grid cells drawn as one node each (an
+    // obstacle if the cell has one) and edges between cells; edges inside a cell are dropped.
+    ViewportGraph getViewportGraph(double minLat, double minLon, double maxLat, double maxLon, size_t maxNodes) const;
+    PackedRTree::Box getGraphBounds() const { return region_index_.bounds(); } // Box of all nodes
 
-    // Obstacle management
+    // Obstacle management. Edits wait for a load or triangulation running on another thread and emit
+    // graphUpdated() after releasing the lock.
     void toggleObstacleNode(int nodeId); // Toggles obstacle status for a single node
     void setObstacleArea(double minLat, double minLon, double maxLat, double maxLon); // Sets obstacles within a bounding box
     void clearAllObstacles(); // Clears all obstacles
+    // Exact area obstacles; both return the number of newly blocked nodes. Polygon rings are
+    // vertex lists (closing vertex optional); a node is inside if it lies inside an odd number
+    // of rings, so holes work. Edges are straight lines in lat/lon, as drawn on the map.
+    int setObstaclePolygon(const std::vector<std::vector<LatLon>>& rings);
+    int setObstacleCircle(const LatLon& center, double radiusKm);
+
+    // Obstacle shape registry. Each shape (e.g. a layer drawn on the map) is registered under a
+    // caller-chosen ID and every node keeps a count of the shapes covering it, so shapes can be
+    // added, edited and removed independently; only nodes entering or leaving a shape are
+    // touched. setObstacleShape adds or replaces a shape and returns the number of covered nodes.
+    int setObstacleShape(int shapeId, const ObstacleShape& shape);
+    bool removeObstacleShape(int shapeId);
+    std::vector<int> getObstacleShapeIds() const;
+
+    // Edge weight overrides (both directions of the edge u-v). A penalty multiplies the stored
+    // haversine length and must be >= 1 so the straight-line A* heuristic stays admissible;
+    // a closed edge is never relaxed. Return false if u-v is not an edge of the graph.
+    bool setEdgePenalty(int uId, int vId, double multiplier);
+    bool closeEdge(int uId, int vId);
+    bool clearEdgeOverride(int uId, int vId);
+    void clearAllEdgeOverrides();
+    bool hasEdgeOverrides() const { return !edge_overrides_.empty(); }
 
     // Getters for graph data (for drawing and route finding)
     const std::vector<Node>& getAllNodes() const { return nodes_; }
-    const std::vector<Edge>& getAllEdges() const { return edges_; }
-    const std::unordered_set<int>& getObstacleNodeIds() const { return obstacle_node_ids_; }
+    std::vector<Edge> getAllEdges() const; // Copy, empty in low-memory mode; thread-safe
+    size_t getEdgeCount() const { return edge_count_.load(); } // Undirected edges of the base adjacency
+    const CoordinateArrays& getCoordinates() const { return coordinates_; } // Node coordinates by dense index (SoA)
+    std::vector<int> getObstacleNodeIds() const; // IDs of blocked nodes, in dense index order
+    bool hasObstacles() const { return !obstacles_.empty(); }
+    const ObstacleBitset& getObstacles() const { return obstacles_; } // Blocked flags by dense index
+    // Copies the coordinates and obstacle flags together, waiting for a load or obstacle edit in
+    // progress; for readers on other threads, which must not read the references above.
+    void copyNodeState(CoordinateArrays& coordinates, ObstacleBitset& obstacles) const;
     Node getNode(int nodeId) const; // Throws if not found
+    int getNodeIndex(int nodeId) const; // Dense index into getAllNodes(), -1 if not found
+    bool isObstacle(int nodeId) const;
+
+    // Incremented on every change to nodes, edges or the obstacle set (but not on no-op obstacle
+    // edits); lets derived data (landmark tables, cached routes) detect that it is out of date.
+    uint64_t getGraphVersion() const { return graph_version_.load(); }
+
+    // Appends the dense indices whose obstacle state changed after graph version 'since' (possibly
+    // with repeats). Returns false if the log cannot tell because nodes, edges or weights changed
+    // since then or the log was trimmed; the caller must then start over. Thread-safe.
+    bool getObstacleChangesSince(uint64_t since, std::vector<int>& changed) const;
+
+    // CSR view of the edges, indexed by dense node index. Null until triangulation has run.
+    // Held by shared_ptr so searches can keep using a snapshot while the graph is rebuilt.
+    // Weights include edge overrides; without overrides this is the base adjacency itself.
+    // The adjacency getters are thread-safe.
+    std::shared_ptr<const CsrAdjacency> getAdjacency() const;
+    std::shared_ptr<const CsrAdjacency> getBaseAdjacency() const;
+
+    // Low-memory mode keeps the adjacency only in compressed form (see compressed_adjacency.h):
+    // the CSR arrays and the edge list are dropped, getAdjacency() and getBaseAdjacency() return
+    // null and searches read getCompressedAdjacency() instead. Weights are rounded up to 1 cm.
+    // Turning it off decodes the CSR arrays and edge list again. Applies to later loads as well.
+    // Waits for a load, triangulation or other toggle running on another thread.
+    void setLowMemoryMode(bool enabled);
+    bool isLowMemoryMode() const { return low_memory_.load(); }
+    // Null unless in low-memory mode; weights include edge overrides, like getAdjacency()
+    std::shared_ptr<const CompressedAdjacency> getCompressedAdjacency() const;
+    bool hasAdjacency() const;
 
 signals:
     // Signal to notify that graph data has changed (e.g., after loading, triangulation, or obstacle change)
@@ -53,11 +169,63 @@ private:
     std::vector<Node> nodes_;
     std::vector<Edge> edges_; // Explicit list of edges after triangulation
     std::unordered_map<int, size_t> node_id_to_index_map_; // Maps node ID to its index in 'nodes_' vector
-    std::unordered_set<int> obstacle_node_ids_; // Stores IDs of nodes currently marked as obstacles
+    ObstacleBitset obstacles_; // Nodes currently marked as obstacles, by dense index
+    // obstacles_ is the union of the two sources below, kept in sync by refreshObstacles()
+    ObstacleBitset manual_obstacles_;    // Toggled nodes and unregistered areas
+    std::vector<uint32_t> shape_refcount_; // Number of registered shapes covering each node
+    std::unordered_map<int, std::vector<int>> obstacle_shapes_; // Shape ID -> covered dense indices (sorted)
+    CoordinateArrays coordinates_; // SoA copy of the node coordinates, rebuilt with the indexes below
+    SpatialIndex spatial_index_; // k-d tree over nodes_, rebuilt whenever the node set changes
+    PackedRTree region_index_;   // R-tree over nodes_ for area queries, rebuilt with spatial_index_
+    // Loads, triangulation, edge overrides, obstacle edits and setLowMemoryMode() run one at a time
+    // under graph_update_mutex_ (saveSnapshot() holds it too, to read a consistent graph). They replace
+    // edges_ and the adjacency pointers below under adjacency_mutex_, which readers on other
+    // threads take to copy them; the writer itself reads them without it.
+    mutable std::mutex graph_update_mutex_;
+    mutable std::mutex adjacency_mutex_;
+    std::shared_ptr<const CsrAdjacency> base_adjacency_; // Built from edges_ by buildAdjacency()
+    std::shared_ptr<const CsrAdjacency> adjacency_;      // base_adjacency_ with edge_overrides_ applied
+    std::shared_ptr<const CompressedAdjacency> compressed_base_;      // Replaces base_adjacency_ in low-memory mode
+    std::shared_ptr<const CompressedAdjacency> compressed_adjacency_; // compressed_base_ with edge_overrides_ applied
+    std::atomic<bool> low_memory_{false};
+    std::atomic<size_t> edge_count_{0};
+    std::unordered_map<uint64_t, double> edge_overrides_; // edgeKey() -> weight multiplier (infinity = closed)
+    std::atomic<uint64_t> graph_version_{0};
+    static constexpr size_t kMaxReportedLoadErrors = 100;
+    std::vector<std::string> load_errors_; // "line N: reason: \"row\"" of the last load
+    size_t load_error_count_ = 0;
+
+    // Obstacle change log for incremental routing, in version order
+    struct ObstacleChange {
+        uint64_t version; // Graph version the change produced
+        int index;
+    };
+    static constexpr size_t kMaxObstacleLogSize = 1 << 20;
+    std::vector<ObstacleChange> obstacle_log_;
+    uint64_t obstacle_log_base_ = 0; // The log holds every obstacle change after this version
+    mutable std::mutex obstacle_log_mutex_;
+    void logObstacleChanges(const std::vector<int>& indices); // Call after bumping graph_version_
+    void resetObstacleLog(); // Call after bumping graph_version_ for non-obstacle changes
+
+    void resetNodeState(); // Sizes obstacle state and coordinates_ for a new nodes_, drops shapes
+    void buildAdjacency(); // Rebuilds base_adjacency_ from edges_, then applies the overrides
+    void reorderNodesAlongHilbertCurve(); // Sorts nodes_ along a Hilbert curve, rebuilds the ID map
+    int blockNodes(const std::vector<int>& indices); // Marks dense indices as obstacles, returns newly blocked count
+    int refreshObstacles(const std::vector<int>& indices); // Recomputes obstacles_ for these nodes, returns changes
+    std::vector<int> nodesInPolygon(const std::vector<std::vector<LatLon>>& rings) const;
+    std::vector<int> nodesInCircle(const LatLon& center, double radiusKm) const;
+    std::vector<int> nodesInShape(const ObstacleShape& shape) const; // Sorted dense indices
+    void applyEdgeOverrides(); // Rebuilds adjacency_ (or compressed_adjacency_) from the base and edge_overrides_
+    void compressBaseAdjacency(); // Moves base_adjacency_ into compressed_base_, drops edges_
+    // Replaces adjacency_ and compressed_adjacency_ together under adjacency_mutex_
+    void publishAdjacency(std::shared_ptr<const CsrAdjacency> adjacency,
+                          std::shared_ptr<const CompressedAdjacency> compressed);
+    bool hasBaseArc(int u, int v) const; // Dense indices
+    std::vector<Edge> edgesFromAdjacency(const CsrAdjacency& csr) const;
+    bool setEdgeOverride(int uId, int vId, double multiplier);
+    uint64_t edgeKey(int u, int v) const; // Order-independent key of two dense indices
 
     // Helper for triangulation: maps OpenCV points back to Node IDs
-    // You'll need a way to quickly look up Node ID by LatLon or by its original index
-    std::unordered_map<cv::Point2f, int, std::hash<cv::Point2f>> cv_point_to_node_id_map_;
     // Custom hash for cv::Point2f for the unordered_map (required)
     struct CvPoint2fHash {
         size_t operator()(const cv::Point2f& p) const {
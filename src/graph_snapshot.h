@@ -0,0 +1,94 @@
+#ifndef GRAPH_SNAPSHOT_H
+#define GRAPH_SNAPSHOT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>     // For std::memcpy
+#include <type_traits>
+#include <QSaveFile>
+
+// Binary graph snapshot format (see GraphManager::saveSnapshot).
+//
+// A snapshot starts with kSnapshotMagic, the format version and a few layout checks, followed
+// by sections in a fixed order, each an array of trivially copyable values: a uint64 element
+// count, the raw bytes and zero padding to a multiple of 8 bytes. Numbers are stored in native
+// byte order; the layout checks reject snapshots written by a different architecture. Readers
+// work on a memory-mapped file and copy each array with one memcpy.
+constexpr char kSnapshotMagic[8] = { 'A', 'E', 'D', 'G', 'R', 'A', 'P', 'H' };
+constexpr uint32_t kSnapshotFormatVersion = 1; // Bump on any change to the sections
+constexpr uint32_t kSnapshotByteOrderMark = 0x01020304;
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(QSaveFile& file) : file_(file) {}
+
+    bool ok() const { return ok_; }
+
+    template <typename T>
+    void writeValue(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        writeBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be trivially copyable");
+        writeValue<uint64_t>(values.size());
+        writeBytes(values.data(), values.size() * sizeof(T));
+        static const char padding[8] = {};
+        if (written_ % 8) writeBytes(padding, 8 - written_ % 8);
+    }
+
+private:
+    void writeBytes(const void* data, size_t size) {
+        if (!ok_ || size == 0) return;
+        ok_ = file_.write(static_cast<const char*>(data), static_cast<qint64>(size)) == static_cast<qint64>(size);
+        written_ += size;
+    }
+
+    QSaveFile& file_;
+    size_t written_ = 0;
+    bool ok_ = true;
+};
+
+// Bounds-checked reader over a snapshot in memory. After the first failed read every further
+// read fails as well, so callers can read all sections and check ok() once.
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return pos_ == size_; }
+
+    template <typename T>
+    bool readValue(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        if (!ok_ || size_ - pos_ < sizeof(T)) return ok_ = false;
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool readArray(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be trivially copyable");
+        uint64_t count = 0;
+        if (!readValue(count) || count > (size_ - pos_) / sizeof(T)) return ok_ = false;
+        values.resize(static_cast<size_t>(count));
+        if (count) std::memcpy(values.data(), data_ + pos_, static_cast<size_t>(count) * sizeof(T));
+        pos_ += static_cast<size_t>(count) * sizeof(T);
+        size_t padding = pos_ % 8 ? 8 - pos_ % 8 : 0;
+        if (size_ - pos_ < padding) return ok_ = false;
+        pos_ += padding;
+        return true;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+#endif // GRAPH_SNAPSHOT_H
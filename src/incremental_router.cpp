@@ -0,0 +1,168 @@
+#include "incremental_router.h"
+#include <algorithm> // For std::push_heap, std::pop_heap, std::make_heap, std::min
+#include <functional> // For std::greater
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+#include "graph_manager.h"
+
+std::vector<int> IncrementalRouter::route(const GraphManager& graph_manager, std::shared_ptr<const CsrAdjacency> graph,
+                                          int origin, int dest, uint64_t graph_version) {
+    expansions_ = 0;
+    repaired_ = false;
+    if (!graph) return {};
+
+    std::vector<int> changed;
+    bool can_repair = graph == graph_ && origin == origin_ && dest == dest_ &&
+                      graph_manager.getObstacleChangesSince(version_, changed);
+    graph_ = graph;
+    version_ = graph_version;
+    if (can_repair) {
+        // An obstacle change alters the cost of every edge at that node: re-evaluate the node
+        // and its neighbors. Re-evaluating a node twice is harmless.
+        repaired_ = true;
+        for (int u : changed) {
+            updateVertex(graph_manager, u);
+            for (size_t k = graph->edgeBegin(u); k < graph->edgeEnd(u); ++k) {
+                updateVertex(graph_manager, graph->targets[k]);
+            }
+        }
+    } else {
+        initialize(graph_manager, origin, dest);
+    }
+
+    computeShortestPath(graph_manager);
+    qDebug() << "IncrementalRouter:" << (repaired_ ? "Repaired" : "Computed") << "search after"
+             << changed.size() << "obstacle changes," << expansions_ << "nodes expanded.";
+    return extractPath(graph_manager);
+}
+
+void IncrementalRouter::initialize(const GraphManager& graph_manager, int origin, int dest) {
+    const size_t n = graph_->nodeCount();
+    origin_ = origin;
+    dest_ = dest;
+    g_.assign(n, kInfinity);
+    rhs_.assign(n, kInfinity);
+    queued_key_.assign(n, Key{ kInfinity, kInfinity });
+    in_queue_.assign(n, 0);
+    queued_ = 0;
+    heap_.clear();
+
+    // Heuristic of every node up front, in parallel chunks of the coordinate kernel
+    graph_manager.getCoordinates().distancesFromNode(static_cast<size_t>(dest), h_);
+
+    rhs_[origin] = 0.0;
+    push(origin);
+}
+
+double IncrementalRouter::edgeCost(const GraphManager& graph_manager, int u, int v, double weight) const {
+    const ObstacleBitset& blocked = graph_manager.getObstacles();
+    return blocked.test(u) || blocked.test(v) ? kInfinity : weight;
+}
+
+IncrementalRouter::Key IncrementalRouter::calculateKey(int u) const {
+    double best = std::min(g_[u], rhs_[u]);
+    return { best + heuristic(u), best };
+}
+
+void IncrementalRouter::push(int u) {
+    Key key = calculateKey(u);
+    if (!in_queue_[u]) {
+        in_queue_[u] = 1;
+        queued_++;
+    }
+    queued_key_[u] = key;
+    heap_.push_back({ key, u });
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<QueueEntry>());
+}
+
+bool IncrementalRouter::topKey(Key& key) {
+    // Entries of dequeued nodes or superseded keys are discarded lazily
+    while (!heap_.empty()) {
+        const QueueEntry& top = heap_.front();
+        if (in_queue_[top.node] && queued_key_[top.node] == top.key) {
+            key = top.key;
+            return true;
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<QueueEntry>());
+        heap_.pop_back();
+    }
+    return false;
+}
+
+void IncrementalRouter::updateVertex(const GraphManager& graph_manager, int u) {
+    if (u != origin_) {
+        double best = kInfinity;
+        for (size_t k = graph_->edgeBegin(u); k < graph_->edgeEnd(u); ++k) {
+            int v = graph_->targets[k];
+            double candidate = g_[v] + edgeCost(graph_manager, v, u, graph_->weights[k]);
+            if (candidate < best) best = candidate;
+        }
+        rhs_[u] = best;
+    }
+    if (g_[u] != rhs_[u]) {
+        push(u); // Also replaces the key of a queued node
+    } else if (in_queue_[u]) {
+        in_queue_[u] = 0; // Now locally consistent; its heap entries become stale
+        queued_--;
+    }
+}
+
+void IncrementalRouter::computeShortestPath(const GraphManager& graph_manager) {
+    Key top;
+    while (topKey(top) && (top < calculateKey(dest_) || rhs_[dest_] != g_[dest_])) {
+        int u = heap_.front().node;
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<QueueEntry>());
+        heap_.pop_back();
+        in_queue_[u] = 0;
+        queued_--;
+        expansions_++;
+
+        if (g_[u] > rhs_[u]) {
+            g_[u] = rhs_[u]; // Overconsistent: settle
+        } else {
+            g_[u] = kInfinity; // Underconsistent: invalidate and re-evaluate u as well
+            updateVertex(graph_manager, u);
+        }
+        for (size_t k = graph_->edgeBegin(u); k < graph_->edgeEnd(u); ++k) {
+            updateVertex(graph_manager, graph_->targets[k]);
+        }
+    }
+
+    // Stale entries pile up during long repair sessions; rebuild from the live ones when they dominate
+    if (heap_.size() > 4 * queued_ + 1024) {
+        heap_.clear();
+        for (size_t u = 0; u < in_queue_.size(); ++u) {
+            if (in_queue_[u]) heap_.push_back({ queued_key_[u], static_cast<int>(u) });
+        }
+        std::make_heap(heap_.begin(), heap_.end(), std::greater<QueueEntry>());
+    }
+}
+
+std::vector<int> IncrementalRouter::extractPath(const GraphManager& graph_manager) const {
+    if (g_[dest_] == kInfinity) return {};
+
+    // Walk back from the destination along predecessors minimizing g(v) + c(v, u)
+    std::vector<int> path = { dest_ };
+    int current = dest_;
+    while (current != origin_) {
+        int best_node = -1;
+        double best = kInfinity;
+        for (size_t k = graph_->edgeBegin(current); k < graph_->edgeEnd(current); ++k) {
+            int v = graph_->targets[k];
+            double candidate = g_[v] + edgeCost(graph_manager, v, current, graph_->weights[k]);
+            if (candidate < best) {
+                best = candidate;
+                best_node = v;
+            }
+        }
+        if (best_node < 0 || path.size() > g_.size()) {
+            qWarning() << "IncrementalRouter: Could not trace the path back to the origin.";
+            return {};
+        }
+        path.push_back(best_node);
+        current = best_node;
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
@@ -0,0 +1,78 @@
+#ifndef INCREMENTAL_ROUTER_H
+#define INCREMENTAL_ROUTER_H
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+#include "data_types.h"
+
+class GraphManager;
+
+// Lifelong Planning A* (LPA*) for one watched origin/destination pair.
+//
+// The search keeps its g and rhs values between queries. When only obstacles changed since the
+// previous query (as reported by GraphManager's obstacle change log), the changed nodes and
+// their neighbors are re-evaluated and the search continues from its old state; only the part
+// of the search affected by the change is expanded again. Blocking a node sets the cost of all
+// its edges to infinity. Any other change (new endpoints, nodes, edges or weights) restarts
+// from scratch. The haversine heuristic is consistent, so the repaired route is exact.
+class IncrementalRouter {
+public:
+    // Shortest path between two dense node indices (source first), empty if unreachable.
+    // 'graph_version' must be read before 'graph' and the obstacle state.
+    std::vector<int> route(const GraphManager& graph_manager, std::shared_ptr<const CsrAdjacency> graph,
+                           int origin, int dest, uint64_t graph_version);
+
+    size_t lastExpansions() const { return expansions_; }
+    bool lastWasRepair() const { return repaired_; }
+
+private:
+    struct Key {
+        double primary;   // min(g, rhs) + h
+        double secondary; // min(g, rhs)
+        bool operator<(const Key& other) const {
+            return primary < other.primary || (primary == other.primary && secondary < other.secondary);
+        }
+        bool operator==(const Key& other) const {
+            return primary == other.primary && secondary == other.secondary;
+        }
+    };
+    struct QueueEntry {
+        Key key;
+        int node;
+        bool operator>(const QueueEntry& other) const { return other.key < key; }
+    };
+
+    static constexpr double kInfinity = std::numeric_limits<double>::infinity();
+
+    void initialize(const GraphManager& graph_manager, int origin, int dest);
+    void computeShortestPath(const GraphManager& graph_manager);
+    void updateVertex(const GraphManager& graph_manager, int u);
+    double edgeCost(const GraphManager& graph_manager, int u, int v, double weight) const;
+    double heuristic(int u) const { return h_[u]; }
+    Key calculateKey(int u) const;
+    void push(int u);
+    bool topKey(Key& key); // Drops stale entries; false if the queue is empty
+    std::vector<int> extractPath(const GraphManager& graph_manager) const;
+
+    std::shared_ptr<const CsrAdjacency> graph_;
+    uint64_t version_ = 0;
+    int origin_ = -1;
+    int dest_ = -1;
+
+    std::vector<double> g_;
+    std::vector<double> rhs_;
+    std::vector<double> h_;        // Haversine to dest
+    std::vector<Key> queued_key_;  // Key of the live queue entry of each node
+    std::vector<char> in_queue_;
+    size_t queued_ = 0;            // Live entries; the heap may hold stale ones as well
+    std::vector<QueueEntry> heap_;
+
+    size_t expansions_ = 0;
+    bool repaired_ = false;
+};
+
+#endif // INCREMENTAL_ROUTER_H
@@ -0,0 +1,107 @@
+#include "landmarks.h"
+#include <algorithm> // For std::push_heap, std::pop_heap
+#include <functional> // For std::greater
+#include <utility>
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+namespace {
+
+// Full single-source Dijkstra over the non-blocked part of the graph
+void dijkstraFrom(const CsrAdjacency& graph, const ObstacleBitset& blocked, int source,
+                  std::vector<double>& dist) {
+    dist.assign(graph.nodeCount(), std::numeric_limits<double>::infinity());
+    std::vector<std::pair<double, int>> heap;
+    dist[source] = 0.0;
+    heap.push_back({0.0, source});
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+        auto [d, u] = heap.back();
+        heap.pop_back();
+        if (d > dist[u]) continue; // Stale entry
+        for (size_t k = graph.edgeBegin(u); k < graph.edgeEnd(u); ++k) {
+            int v = graph.targets[k];
+            if (blocked.test(v)) continue;
+            double nd = d + graph.weights[k];
+            if (nd < dist[v]) {
+                dist[v] = nd;
+                heap.push_back({nd, v});
+                std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+            }
+        }
+    }
+}
+
+} // namespace
+
+void LandmarkIndex::build(std::shared_ptr<const CsrAdjacency> graph, const CoordinateArrays& coords,
+                          const ObstacleBitset& blocked, size_t count, uint64_t graph_version) {
+    source_ = graph;
+    version_ = graph_version;
+    landmarks_.clear();
+    distances_.clear();
+    if (!graph || graph->nodeCount() == 0 || coords.size() != graph->nodeCount()) return;
+
+    const size_t n = graph->nodeCount();
+
+    // Farthest-point selection: start from the node farthest from an arbitrary free node, then
+    // repeatedly take the node maximizing the distance to its closest landmark so far
+    std::vector<double> min_dist(n, std::numeric_limits<double>::infinity());
+    int seed = -1;
+    for (size_t v = 0; v < n && seed < 0; ++v) {
+        if (!blocked.test(v)) seed = static_cast<int>(v);
+    }
+    if (seed < 0) return; // Everything is blocked
+    coords.distancesFromNode(static_cast<size_t>(seed), min_dist);
+    std::vector<double> landmark_dist;
+
+    while (landmarks_.size() < count) {
+        int best = -1;
+        double best_dist = -1.0;
+        #pragma omp parallel
+        {
+            int local_best = -1;
+            double local_dist = -1.0;
+            #pragma omp for nowait
+            for (size_t v = 0; v < n; ++v) {
+                if (!blocked.test(v) && min_dist[v] > local_dist) {
+                    local_dist = min_dist[v];
+                    local_best = static_cast<int>(v);
+                }
+            }
+            #pragma omp critical(landmark_argmax)
+            {
+                if (local_dist > best_dist || (local_dist == best_dist && local_best < best)) {
+                    best_dist = local_dist;
+                    best = local_best;
+                }
+            }
+        }
+        if (best < 0 || best_dist <= 0.0) break; // Fewer distinct free nodes than requested landmarks
+        landmarks_.push_back(best);
+
+        coords.distancesFromNode(static_cast<size_t>(best), landmark_dist);
+        #pragma omp parallel for
+        for (size_t v = 0; v < n; ++v) {
+            if (landmark_dist[v] < min_dist[v]) min_dist[v] = landmark_dist[v];
+        }
+    }
+
+    // One independent Dijkstra per landmark, written into the node-major table
+    const size_t k = landmarks_.size();
+    distances_.assign(n * k, kUnreachable);
+    #pragma omp parallel
+    {
+        std::vector<double> dist;
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t i = 0; i < k; ++i) {
+            dijkstraFrom(*graph, blocked, landmarks_[i], dist);
+            for (size_t v = 0; v < n; ++v) {
+                distances_[v * k + i] = dist[v];
+            }
+        }
+    }
+
+    qDebug() << "LandmarkIndex: Built" << k << "landmark tables for" << n << "nodes (graph version"
+             << graph_version << ").";
+}
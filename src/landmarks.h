@@ -0,0 +1,59 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+#include "data_types.h"
+#include "coordinate_arrays.h"
+#include "obstacle_bitset.h"
+
+// ALT (A*, Landmarks, Triangle inequality) lower bounds.
+//
+// For a landmark L the triangle inequality gives d(v, t) >= |d(L, t) - d(L, v)| on an undirected
+// graph; the maximum over all landmarks is an admissible and consistent A* potential that,
+// unlike haversine, accounts for detours forced by obstacles. Distance tables are computed on the
+// graph with obstacles removed, so a table is only valid for the graph version it was built for.
+class LandmarkIndex {
+public:
+    // Picks 'count' landmarks by farthest-point selection (great-circle distance, so all
+    // Dijkstra runs are independent) and fills the distance tables with one Dijkstra per
+    // landmark, in parallel. 'blocked' is indexed by dense node index.
+    void build(std::shared_ptr<const CsrAdjacency> graph, const CoordinateArrays& coords,
+               const ObstacleBitset& blocked, size_t count, uint64_t graph_version);
+
+    bool isValidFor(const std::shared_ptr<const CsrAdjacency>& graph, uint64_t graph_version) const {
+        return graph && source_ == graph && version_ == graph_version && !landmarks_.empty();
+    }
+    size_t landmarkCount() const { return landmarks_.size(); }
+
+    // max over landmarks of |d(L, target) - d(L, v)|; infinity if v provably cannot reach target
+    double lowerBound(int v, int target) const {
+        const double* dv = &distances_[static_cast<size_t>(v) * landmarks_.size()];
+        const double* dt = &distances_[static_cast<size_t>(target) * landmarks_.size()];
+        double bound = 0.0;
+        for (size_t i = 0; i < landmarks_.size(); ++i) {
+            bool v_reached = dv[i] < kUnreachable;
+            bool t_reached = dt[i] < kUnreachable;
+            if (v_reached != t_reached) return kUnreachable; // Different components
+            if (v_reached) {
+                double diff = dt[i] > dv[i] ? dt[i] - dv[i] : dv[i] - dt[i];
+                if (diff > bound) bound = diff;
+            }
+        }
+        return bound;
+    }
+
+private:
+    static constexpr double kUnreachable = std::numeric_limits<double>::infinity();
+
+    std::shared_ptr<const CsrAdjacency> source_;
+    uint64_t version_ = 0;
+    std::vector<int> landmarks_;   // Dense indices of the landmark nodes
+    std::vector<double> distances_; // Node-major: distances_[v * landmarkCount() + i] = d(L_i, v)
+};
+
+#endif // LANDMARKS_H
@@ -88,9 +88,11 @@ int main(int argc, char *argv[]) {
     // --- UI Buttons and Actions ---
     QMenuBar *menuBar = window.menuBar();
     QMenu *fileMenu = menuBar->addMenu("&File");
-    QAction *loadNodesAction = fileMenu->addAction("&Load Nodes from CSV...");
+    QAction *loadNodesAction = fileMenu->addAction("&Load Nodes from CSV or OSM...");
     QObject::connect(loadNodesAction, &QAction::triggered, [&]() {
-        QString fileName = QFileDialog::getOpenFileName(&window, "Open Node CSV File", "", "CSV Files (*.csv);;All Files (*)");
+        QString fileName = QFileDialog::getOpenFileName(&window, "Open Node CSV or OpenStreetMap File", "",
+                                                        "Graph Files (*.csv *.osm *.pbf);;CSV Files (*.csv);;"
+                                                        "OpenStreetMap Files (*.osm *.pbf);;All Files (*)");
         if (!fileName.isEmpty()) {
             appController.loadGraphData(fileName);
         }
@@ -138,6 +140,58 @@ int main(int argc, char *argv[]) {
     QAction *findRouteAction = routeMenu->addAction("&Find Route");
     QObject::connect(findRouteAction, &QAction::triggered, &appController, &AppController::findRoute);
 
+    QMenu *algorithmMenu = routeMenu->addMenu("&Algorithm");
+    QActionGroup *algorithmGroup = new QActionGroup(&window);
+    algorithmGroup->setExclusive(true);
+
+    QAction *astarAction = algorithmMenu->addAction("&A*");
+    astarAction->setCheckable(true);
+    astarAction->setChecked(true);
+    algorithmGroup->addAction(astarAction);
+    QObject::connect(astarAction, &QAction::triggered, [&](){
+        appController.setRoutingAlgorithm(RoutingAlgorithm::AStar);
+    });
+
+    QAction *bidirectionalAction = algorithmMenu->addAction("&Bidirectional A*");
+    bidirectionalAction->setCheckable(true);
+    algorithmGroup->addAction(bidirectionalAction);
+    QObject::connect(bidirectionalAction, &QAction::triggered, [&](){
+        appController.setRoutingAlgorithm(RoutingAlgorithm::BidirectionalAStar);
+    });
+
+    QAction *chAction = algorithmMenu->addAction("&Contraction Hierarchies");
+    chAction->setCheckable(true);
+    algorithmGroup->addAction(chAction);
+    QObject::connect(chAction, &QAction::triggered, [&](){
+        appController.setRoutingAlgorithm(RoutingAlgorithm::ContractionHierarchies);
+    });
+
+    QAction *altAction = algorithmMenu->addAction("A* with &Landmarks (ALT)");
+    altAction->setCheckable(true);
+    algorithmGroup->addAction(altAction);
+    QObject::connect(altAction, &QAction::triggered, [&](){
+        appController.setRoutingAlgorithm(RoutingAlgorithm::ALT);
+    });
+
+    QAction *incrementalAction = algorithmMenu->addAction("&Incremental (LPA*)");
+    incrementalAction->setCheckable(true);
+    algorithmGroup->addAction(incrementalAction);
+    QObject::connect(incrementalAction, &QAction::triggered, [&](){
+        appController.setRoutingAlgorithm(RoutingAlgorithm::Incremental);
+    });
+
+    routeMenu->addSeparator();
+    QAction *lowMemoryAction = routeMenu->addAction("&Low-Memory Adjacency");
+    lowMemoryAction->setCheckable(true);
+    // Disabled while a toggle runs, so toggles never overlap
+    QObject::connect(lowMemoryAction, &QAction::toggled, [&, lowMemoryAction](bool checked){
+        lowMemoryAction->setEnabled(false);
+        appController.setLowMemoryMode(checked);
+    });
+    QObject::connect(&appController, &AppController::lowMemoryModeApplied, lowMemoryAction, [lowMemoryAction](bool){
+        lowMemoryAction->setEnabled(true);
+    });
+
 
     window.setCentralWidget(centralWidget);
     window.show();
@@ -29,20 +29,32 @@ public slots:
         emit nodeSelectionRequested(nodeId);
     }
 
-    // Called from JS when user draws a single marker obstacle
-    Q_INVOKABLE void onObstacleMarkerDrawn(double lat, double lon) {
-        qDebug() << "FROM JAVASCRIPT: Obstacle marker drawn at Lat:" << lat << ", Lon:" << lon;
-        emit obstacleMarkerDrawn(LatLon(lat, lon));
+    // Called from JS when user draws an obstacle shape (polygon, rectangle, circle or marker).
+    // 'shapeId' is the Leaflet layer ID and 'geoJson' the layer's GeoJSON Feature; circles are a
+    // Point with the radius (meters) in properties.radius, markers a Point without radius.
+    Q_INVOKABLE void onObstacleShapeDrawn(int shapeId, const QString &geoJson) {
+        qDebug() << "FROM JAVASCRIPT: Obstacle shape" << shapeId << "drawn (" << geoJson.size() << "bytes of GeoJSON)";
+        emit obstacleShapeChanged(shapeId, geoJson);
     }
 
-    // Called from JS when user draws a rectangular or polygonal obstacle area
-    Q_INVOKABLE void onObstacleAreaDrawn(double minLat, double minLon, double maxLat, double maxLon) {
-        qDebug() << "FROM JAVASCRIPT: Obstacle area drawn (bbox): "
+    // Called from JS when user edits a drawn obstacle shape, same arguments as onObstacleShapeDrawn
+    Q_INVOKABLE void onObstacleShapeEdited(int shapeId, const QString &geoJson) {
+        qDebug() << "FROM JAVASCRIPT: Obstacle shape" << shapeId << "edited";
+        emit obstacleShapeChanged(shapeId, geoJson);
+    }
+
+    // Called from JS when user deletes a drawn obstacle shape
+    Q_INVOKABLE void onObstacleShapeDeleted(int shapeId) {
+        qDebug() << "FROM JAVASCRIPT: Obstacle shape" << shapeId << "deleted";
+        emit obstacleShapeDeleted(shapeId);
+    }
+
+    // Called from JS after the map was panned or zoomed, with the visible bounds
+    Q_INVOKABLE void onViewportChanged(double minLat, double minLon, double maxLat, double maxLon) {
+        qDebug() << "FROM JAVASCRIPT: Viewport changed to"
                  << "minLat=" << minLat << ", minLon=" << minLon
                  << ", maxLat=" << maxLat << ", maxLon=" << maxLon;
-        // QRectF uses (left, top, width, height). For geographic, it's (minLon, maxLat, (maxLon-minLon), (minLat-maxLat))
-        // Or you can just pass the 4 doubles. Let's pass the 4 doubles directly for clarity.
-        emit obstacleAreaDrawn(minLat, minLon, maxLat, maxLon);
+        emit viewportChanged(minLat, minLon, maxLat, maxLon);
     }
 
     // A general log function from JS for debugging
@@ -54,9 +66,9 @@ signals:
     // Signals to communicate map events to other C++ backend components
     void mapReady();
     void nodeSelectionRequested(int nodeId);
-    void obstacleMarkerDrawn(const LatLon& coords);
-    void obstacleAreaDrawn(double minLat, double minLon, double maxLat, double maxLon);
-    // You might add signals for clearing obstacles, editing drawn shapes etc.
+    void obstacleShapeChanged(int shapeId, const QString& geoJson); // Drawn or edited
+    void obstacleShapeDeleted(int shapeId);
+    void viewportChanged(double minLat, double minLon, double maxLat, double maxLon);
 };
 
 #endif // MAP_INTERFACE_H
@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <QFile>
+#include <QByteArray>
+
+// Read-only view of the whole contents of an open file. The file is memory-mapped; files that
+// cannot be mapped (pipes, some network file systems) are read into a buffer instead. The view
+// stays valid while this object and the QFile are alive; the mapping is released with this object.
+class MappedFile {
+public:
+    explicit MappedFile(QFile& file) : file_(file) {
+        const qint64 size = file.size();
+        if (size <= 0) return;
+        mapped_ = file.map(0, size);
+        if (mapped_) {
+            data_ = reinterpret_cast<const char*>(mapped_);
+            size_ = static_cast<size_t>(size);
+        } else {
+            buffer_ = file.readAll();
+            data_ = buffer_.constData();
+            size_ = static_cast<size_t>(buffer_.size());
+        }
+    }
+    ~MappedFile() {
+        if (mapped_) file_.unmap(mapped_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; } // Null for an empty file
+    const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(data_); }
+    size_t size() const { return size_; }
+
+private:
+    QFile& file_;
+    uchar* mapped_ = nullptr;
+    QByteArray buffer_; // Contents when the file could not be mapped
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,95 @@
+#ifndef OBSTACLE_BITSET_H
+#define OBSTACLE_BITSET_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Set of blocked nodes, one bit per dense node index.
+//
+// Every 64-bit word carries the epoch it was last written in, and words from an older epoch
+// read as empty, so clear() only bumps the epoch instead of touching every word. The word
+// and its epoch sit next to each other, so a membership test in the search inner loops is a
+// single load followed by the bit test.
+class ObstacleBitset {
+public:
+    // Resizes to 'n' nodes, all unblocked
+    void resize(size_t n) {
+        words_.assign((n + 63) / 64, Word());
+        size_ = n;
+        count_ = 0;
+        epoch_ = 1; // Words start at epoch 0, i.e. stale and empty
+    }
+
+    size_t size() const { return size_; }
+    size_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    bool test(size_t i) const {
+        const Word& word = words_[i >> 6];
+        return word.epoch == epoch_ && ((word.bits >> (i & 63)) & 1u);
+    }
+
+    // Both return true if the bit changed
+    bool set(size_t i) {
+        Word& word = current(i >> 6);
+        uint64_t mask = uint64_t(1) << (i & 63);
+        if (word.bits & mask) return false;
+        word.bits |= mask;
+        count_++;
+        return true;
+    }
+    bool reset(size_t i) {
+        Word& word = current(i >> 6);
+        uint64_t mask = uint64_t(1) << (i & 63);
+        if (!(word.bits & mask)) return false;
+        word.bits &= ~mask;
+        count_--;
+        return true;
+    }
+
+    void clear() {
+        if (count_ == 0) return;
+        count_ = 0;
+        if (++epoch_ == 0) { // Wrapped after 2^32 clears: do one real clear
+            for (auto& word : words_) word = Word();
+            epoch_ = 1;
+        }
+    }
+
+    // Set indices in ascending order
+    std::vector<int> indices() const {
+        std::vector<int> result;
+        result.reserve(count_);
+        for (size_t w = 0; w < words_.size(); ++w) {
+            if (words_[w].epoch != epoch_) continue;
+            for (uint64_t bits = words_[w].bits; bits; bits &= bits - 1) {
+                result.push_back(static_cast<int>(w * 64 + __builtin_ctzll(bits)));
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Word {
+        uint64_t bits = 0;
+        uint32_t epoch = 0;
+    };
+
+    // Word w, emptied first if it is left over from an earlier epoch
+    Word& current(size_t w) {
+        Word& word = words_[w];
+        if (word.epoch != epoch_) {
+            word.bits = 0;
+            word.epoch = epoch_;
+        }
+        return word;
+    }
+
+    std::vector<Word> words_;
+    size_t size_ = 0;
+    size_t count_ = 0;
+    uint32_t epoch_ = 1;
+};
+
+#endif // OBSTACLE_BITSET_H
@@ -0,0 +1,569 @@
+#include "osm_importer.h"
+#include "mapped_file.h"
+#include <QFile>
+#include <QByteArray>
+#include <QXmlStreamReader>
+#include <QDebug>
+#include <algorithm> // For std::sort, std::unique, std::lower_bound, std::is_sorted
+#include <cstring>   // For std::memcmp, std::strlen
+#include <cstdint>
+#include <omp.h>     // For OpenMP
+
+double haversineDistance(double lat1, double lon1, double lat2, double lon2); // Forward declaration
+
+namespace {
+
+struct OsmNode {
+    int64_t id;
+    double lat, lon;
+};
+
+// Everything one part of the file contributes: all nodes with coordinates and the node
+// references of the routable highway ways, flattened
+struct OsmBlock {
+    std::vector<OsmNode> nodes;
+    std::vector<int64_t> refs;
+    std::vector<size_t> way_sizes; // Consecutive ways use consecutive runs of 'refs'
+    std::string error;
+};
+
+// highway=* values of streets a vehicle or pedestrian can be routed along; footways, paths,
+// steps, cycleways and non-streets (construction, proposed, platform, ...) are left out
+const char* const kRoutableHighways[] = {
+    "motorway", "motorway_link", "trunk", "trunk_link", "primary", "primary_link",
+    "secondary", "secondary_link", "tertiary", "tertiary_link", "unclassified",
+    "residential", "living_street", "service", "road", "track", "pedestrian",
+};
+
+bool isRoutableHighway(const char* value, size_t length) {
+    for (const char* highway : kRoutableHighways) {
+        if (std::strlen(highway) == length && std::memcmp(highway, value, length) == 0) return true;
+    }
+    return false;
+}
+
+// --- OSM XML ---
+
+bool readXml(QFile& file, OsmBlock& block) {
+    QXmlStreamReader xml(&file);
+    std::vector<int64_t> way_refs;
+    bool in_way = false, routable = false, area = false;
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement()) {
+            const QXmlStreamAttributes attributes = xml.attributes();
+            if (xml.name() == QLatin1String("node")) {
+                bool id_ok = false, lat_ok = false, lon_ok = false;
+                OsmNode node;
+                node.id = attributes.value(QLatin1String("id")).toLongLong(&id_ok);
+                node.lat = attributes.value(QLatin1String("lat")).toDouble(&lat_ok);
+                node.lon = attributes.value(QLatin1String("lon")).toDouble(&lon_ok);
+                if (id_ok && lat_ok && lon_ok) block.nodes.push_back(node);
+            } else if (xml.name() == QLatin1String("way")) {
+                in_way = true;
+                routable = area = false;
+                way_refs.clear();
+            } else if (in_way && xml.name() == QLatin1String("nd")) {
+                bool ok = false;
+                int64_t ref = attributes.value(QLatin1String("ref")).toLongLong(&ok);
+                if (ok) way_refs.push_back(ref);
+            } else if (in_way && xml.name() == QLatin1String("tag")) {
+                const std::string key = attributes.value(QLatin1String("k")).toString().toStdString();
+                const std::string value = attributes.value(QLatin1String("v")).toString().toStdString();
+                if (key == "highway") routable = isRoutableHighway(value.data(), value.size());
+                else if (key == "area") area = value == "yes";
+            }
+        } else if (xml.isEndElement() && xml.name() == QLatin1String("way")) {
+            if (routable && !area && way_refs.size() >= 2) {
+                block.refs.insert(block.refs.end(), way_refs.begin(), way_refs.end());
+                block.way_sizes.push_back(way_refs.size());
+            }
+            in_way = false;
+        }
+    }
+    if (xml.hasError()) {
+        block.error = "XML error at line " + std::to_string(xml.lineNumber()) + ": " + xml.errorString().toStdString();
+        return false;
+    }
+    return true;
+}
+
+// --- OSM PBF ---
+// The file is a sequence of blobs, each a 4-byte big-endian BlobHeader length, the BlobHeader and
+// the Blob. OSMData blobs hold one zlib-compressed PrimitiveBlock each and decode independently.
+// Only the protobuf fields needed for coordinates and highway ways are read; see
+// https://wiki.openstreetmap.org/wiki/PBF_Format for the message definitions.
+
+// Minimal protobuf wire-format reader. Malformed input sets ok = false; reads then return 0.
+class ProtoReader {
+public:
+    ProtoReader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return !ok_ || p_ >= end_; }
+    void fail() { ok_ = false; } // E.g. when a sub-message read from this one is malformed
+
+    // Next field key; false at the end of the message
+    bool next(uint32_t& field, uint32_t& wire_type) {
+        if (atEnd()) return false;
+        uint64_t key = varint();
+        field = static_cast<uint32_t>(key >> 3);
+        wire_type = static_cast<uint32_t>(key & 7);
+        return ok_;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p_ >= end_) break;
+            uint8_t byte = *p_++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    int64_t svarint() { // ZigZag-encoded sint64
+        uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Length-delimited field (bytes, string, sub-message or packed repeated field)
+    ProtoReader bytes() {
+        uint64_t length = varint();
+        if (!ok_ || length > static_cast<uint64_t>(end_ - p_)) {
+            ok_ = false;
+            return ProtoReader(end_, 0);
+        }
+        ProtoReader sub(p_, static_cast<size_t>(length));
+        p_ += length;
+        return sub;
+    }
+
+    void skip(uint32_t wire_type) {
+        switch (wire_type) {
+            case 0: varint(); break;
+            case 1: advance(8); break;
+            case 2: bytes(); break;
+            case 5: advance(4); break;
+            default: ok_ = false; break; // Groups are not used by the format
+        }
+    }
+
+    const uint8_t* data() const { return p_; }
+    size_t size() const { return static_cast<size_t>(end_ - p_); }
+
+private:
+    void advance(size_t n) {
+        if (static_cast<size_t>(end_ - p_) < n) ok_ = false;
+        else p_ += n;
+    }
+
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
+
+// Reads a repeated field, packed (wire type 2) or as a single value, calling 'read' per value
+template <typename Read>
+void readRepeated(ProtoReader& reader, uint32_t wire_type, Read read) {
+    if (wire_type == 2) {
+        ProtoReader packed = reader.bytes();
+        while (!packed.atEnd()) read(packed);
+        if (!packed.ok()) reader.fail();
+    } else {
+        read(reader);
+    }
+}
+
+struct StringRef {
+    const uint8_t* data;
+    size_t size;
+    bool equals(const char* s) const { return std::strlen(s) == size && std::memcmp(s, data, size) == 0; }
+};
+
+struct BlockCoordinates {
+    int64_t granularity = 100; // Nanodegrees per unit
+    int64_t lat_offset = 0;
+    int64_t lon_offset = 0;
+    double lat(int64_t value) const { return 1e-9 * static_cast<double>(lat_offset + granularity * value); }
+    double lon(int64_t value) const { return 1e-9 * static_cast<double>(lon_offset + granularity * value); }
+};
+
+void readDenseNodes(ProtoReader reader, const BlockCoordinates& coords, OsmBlock& block) {
+    std::vector<int64_t> ids, lats, lons;
+    uint32_t field, wire_type;
+    while (reader.next(field, wire_type)) {
+        std::vector<int64_t>* target = field == 1 ? &ids : field == 8 ? &lats : field == 9 ? &lons : nullptr;
+        if (!target) {
+            reader.skip(wire_type);
+            continue;
+        }
+        readRepeated(reader, wire_type, [target](ProtoReader& r) { target->push_back(r.svarint()); });
+    }
+    if (!reader.ok() || ids.size() != lats.size() || ids.size() != lons.size()) {
+        block.error = "malformed DenseNodes";
+        return;
+    }
+    // All three columns are delta-coded
+    int64_t id = 0, lat = 0, lon = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        id += ids[i];
+        lat += lats[i];
+        lon += lons[i];
+        block.nodes.push_back({ id, coords.lat(lat), coords.lon(lon) });
+    }
+}
+
+void readNode(ProtoReader reader, const BlockCoordinates& coords, OsmBlock& block) {
+    OsmNode node{ 0, 0.0, 0.0 };
+    uint32_t field, wire_type;
+    while (reader.next(field, wire_type)) {
+        if (field == 1 && wire_type == 0) node.id = reader.svarint();
+        else if (field == 8 && wire_type == 0) node.lat = coords.lat(reader.svarint());
+        else if (field == 9 && wire_type == 0) node.lon = coords.lon(reader.svarint());
+        else reader.skip(wire_type);
+    }
+    if (reader.ok()) block.nodes.push_back(node);
+    else block.error = "malformed Node";
+}
+
+void readWay(ProtoReader reader, const std::vector<StringRef>& strings, OsmBlock& block) {
+    std::vector<uint32_t> keys, values;
+    std::vector<int64_t> refs;
+    uint32_t field, wire_type;
+    while (reader.next(field, wire_type)) {
+        if (field == 2 || field == 3) {
+            std::vector<uint32_t>& target = field == 2 ? keys : values;
+            readRepeated(reader, wire_type, [&target](ProtoReader& r) { target.push_back(static_cast<uint32_t>(r.varint())); });
+        } else if (field == 8) {
+            int64_t ref = 0; // Delta-coded
+            readRepeated(reader, wire_type, [&refs, &ref](ProtoReader& r) { refs.push_back(ref += r.svarint()); });
+        } else {
+            reader.skip(wire_type);
+        }
+    }
+    if (!reader.ok() || keys.size() != values.size()) {
+        block.error = "malformed Way";
+        return;
+    }
+
+    bool routable = false, area = false;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] >= strings.size() || values[i] >= strings.size()) {
+            block.error = "Way tag outside the string table";
+            return;
+        }
+        const StringRef& key = strings[keys[i]];
+        const StringRef& value = strings[values[i]];
+        if (key.equals("highway")) routable = isRoutableHighway(reinterpret_cast<const char*>(value.data), value.size);
+        else if (key.equals("area")) area = value.equals("yes");
+    }
+    if (routable && !area && refs.size() >= 2) {
+        block.refs.insert(block.refs.end(), refs.begin(), refs.end());
+        block.way_sizes.push_back(refs.size());
+    }
+}
+
+void readPrimitiveBlock(ProtoReader reader, OsmBlock& block) {
+    std::vector<StringRef> strings;
+    std::vector<ProtoReader> groups;
+    BlockCoordinates coords;
+    uint32_t field, wire_type;
+    while (reader.next(field, wire_type)) {
+        if (field == 1 && wire_type == 2) {
+            ProtoReader table = reader.bytes();
+            uint32_t table_field, table_wire_type;
+            while (table.next(table_field, table_wire_type)) {
+                if (table_field == 1 && table_wire_type == 2) {
+                    ProtoReader s = table.bytes();
+                    strings.push_back({ s.data(), s.size() });
+                } else {
+                    table.skip(table_wire_type);
+                }
+            }
+            if (!table.ok()) reader.fail();
+        } else if (field == 2 && wire_type == 2) {
+            groups.push_back(reader.bytes()); // Decoded below, once the coordinate scale is known
+        } else if (field == 17 && wire_type == 0) {
+            coords.granularity = static_cast<int64_t>(reader.varint());
+        } else if (field == 19 && wire_type == 0) {
+            coords.lat_offset = static_cast<int64_t>(reader.varint());
+        } else if (field == 20 && wire_type == 0) {
+            coords.lon_offset = static_cast<int64_t>(reader.varint());
+        } else {
+            reader.skip(wire_type);
+        }
+    }
+    if (!reader.ok()) {
+        block.error = "malformed PrimitiveBlock";
+        return;
+    }
+
+    for (ProtoReader& group : groups) {
+        while (block.error.empty() && group.next(field, wire_type)) {
+            if (wire_type != 2) group.skip(wire_type);
+            else if (field == 1) readNode(group.bytes(), coords, block);
+            else if (field == 2) readDenseNodes(group.bytes(), coords, block);
+            else if (field == 3) readWay(group.bytes(), strings, block);
+            else group.skip(wire_type); // Relations and changesets
+        }
+        if (block.error.empty() && !group.ok()) block.error = "malformed PrimitiveGroup";
+    }
+}
+
+void readBlob(const uint8_t* data, size_t size, OsmBlock& block) {
+    ProtoReader reader(data, size);
+    ProtoReader raw(data, 0), zlib_data(data, 0);
+    bool has_raw = false, has_zlib = false;
+    uint64_t raw_size = 0;
+    uint32_t field, wire_type;
+    while (reader.next(field, wire_type)) {
+        if (field == 1 && wire_type == 2) { raw = reader.bytes(); has_raw = true; }
+        else if (field == 2 && wire_type == 0) raw_size = reader.varint();
+        else if (field == 3 && wire_type == 2) { zlib_data = reader.bytes(); has_zlib = true; }
+        else reader.skip(wire_type);
+    }
+    if (!reader.ok()) {
+        block.error = "malformed Blob";
+    } else if (has_raw) {
+        readPrimitiveBlock(raw, block);
+    } else if (has_zlib) {
+        // qUncompress expects the uncompressed size as a 4-byte big-endian prefix
+        QByteArray compressed;
+        compressed.reserve(static_cast<int>(zlib_data.size() + 4));
+        const char size_prefix[4] = { static_cast<char>(raw_size >> 24), static_cast<char>(raw_size >> 16),
+                                      static_cast<char>(raw_size >> 8), static_cast<char>(raw_size) };
+        compressed.append(size_prefix, 4);
+        compressed.append(reinterpret_cast<const char*>(zlib_data.data()), static_cast<int>(zlib_data.size()));
+        QByteArray uncompressed = qUncompress(compressed);
+        if (uncompressed.isEmpty() || static_cast<uint64_t>(uncompressed.size()) != raw_size) {
+            block.error = "corrupt zlib data";
+            return;
+        }
+        readPrimitiveBlock(ProtoReader(reinterpret_cast<const uint8_t*>(uncompressed.constData()),
+                                       static_cast<size_t>(uncompressed.size())), block);
+    } else {
+        block.error = "unsupported blob compression (only zlib and raw are)";
+    }
+}
+
+bool readPbf(const uint8_t* data, size_t size, std::vector<OsmBlock>& blocks, std::string& error) {
+    // Framing pass: locate the OSMData blobs
+    struct BlobSpan { size_t offset, size; };
+    std::vector<BlobSpan> spans;
+    size_t pos = 0;
+    while (pos < size) {
+        if (size - pos < 4) {
+            error = "truncated blob header length";
+            return false;
+        }
+        size_t header_size = (static_cast<size_t>(data[pos]) << 24) | (static_cast<size_t>(data[pos + 1]) << 16) |
+                             (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        pos += 4;
+        if (header_size > size - pos) {
+            error = "truncated blob header";
+            return false;
+        }
+        ProtoReader header(data + pos, header_size);
+        bool is_data = false;
+        uint64_t blob_size = 0;
+        uint32_t field, wire_type;
+        while (header.next(field, wire_type)) {
+            if (field == 1 && wire_type == 2) {
+                ProtoReader type = header.bytes();
+                is_data = StringRef{ type.data(), type.size() }.equals("OSMData");
+            } else if (field == 3 && wire_type == 0) {
+                blob_size = header.varint();
+            } else {
+                header.skip(wire_type);
+            }
+        }
+        pos += header_size;
+        if (!header.ok() || blob_size > size - pos) {
+            error = "malformed or truncated blob at byte " + std::to_string(pos);
+            return false;
+        }
+        if (is_data) spans.push_back({ pos, static_cast<size_t>(blob_size) });
+        pos += blob_size;
+    }
+
+    blocks.resize(spans.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < spans.size(); ++i) {
+        readBlob(data + spans[i].offset, spans[i].size, blocks[i]);
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (!blocks[i].error.empty()) {
+            error = "block " + std::to_string(i) + ": " + blocks[i].error;
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Graph construction ---
+
+struct SegmentEdge {
+    int a, b; // Indices into the used node list, a < b
+    double length_km;
+    bool operator<(const SegmentEdge& other) const {
+        if (a != other.a) return a < other.a;
+        if (b != other.b) return b < other.b;
+        return length_km < other.length_km;
+    }
+};
+
+void buildNetwork(std::vector<OsmBlock>& blocks, OsmRoadNetwork& network) {
+    // Merge the blocks in file order
+    std::vector<OsmNode> nodes;
+    std::vector<int64_t> refs;
+    std::vector<size_t> way_offsets{ 0 };
+    for (OsmBlock& block : blocks) {
+        nodes.insert(nodes.end(), block.nodes.begin(), block.nodes.end());
+        refs.insert(refs.end(), block.refs.begin(), block.refs.end());
+        for (size_t way_size : block.way_sizes) way_offsets.push_back(way_offsets.back() + way_size);
+        block = OsmBlock(); // Release as we go
+    }
+    auto by_id = [](const OsmNode& a, const OsmNode& b) { return a.id < b.id; };
+    if (!std::is_sorted(nodes.begin(), nodes.end(), by_id)) std::sort(nodes.begin(), nodes.end(), by_id);
+    const size_t way_count = way_offsets.size() - 1;
+
+    // Nodes referenced by the kept ways, and how often
+    std::vector<int64_t> used_ids(refs);
+    std::sort(used_ids.begin(), used_ids.end());
+    std::vector<uint32_t> use_count;
+    size_t unique_count = 0;
+    for (size_t i = 0; i < used_ids.size();) {
+        size_t j = i;
+        while (j < used_ids.size() && used_ids[j] == used_ids[i]) ++j;
+        used_ids[unique_count++] = used_ids[i];
+        use_count.push_back(static_cast<uint32_t>(j - i));
+        i = j;
+    }
+    used_ids.resize(unique_count);
+
+    std::vector<int64_t> node_pos(unique_count); // Position in 'nodes', -1 if outside the extract
+    #pragma omp parallel for
+    for (size_t u = 0; u < unique_count; ++u) {
+        OsmNode key{ used_ids[u], 0.0, 0.0 };
+        auto it = std::lower_bound(nodes.begin(), nodes.end(), key, by_id);
+        node_pos[u] = (it != nodes.end() && it->id == used_ids[u]) ? it - nodes.begin() : -1;
+    }
+    std::vector<int> ref_index(refs.size()); // Position of each reference in used_ids
+    #pragma omp parallel for
+    for (size_t k = 0; k < refs.size(); ++k) {
+        ref_index[k] = static_cast<int>(std::lower_bound(used_ids.begin(), used_ids.end(), refs[k]) - used_ids.begin());
+    }
+
+    // Graph nodes: shared nodes, and both ends of every run of nodes present in the extract
+    std::vector<char> is_junction(unique_count);
+    for (size_t u = 0; u < unique_count; ++u) is_junction[u] = use_count[u] > 1;
+    for (size_t w = 0; w < way_count; ++w) {
+        for (size_t k = way_offsets[w]; k < way_offsets[w + 1]; ++k) {
+            if (node_pos[ref_index[k]] < 0) continue;
+            bool run_start = k == way_offsets[w] || node_pos[ref_index[k - 1]] < 0;
+            bool run_end = k + 1 == way_offsets[w + 1] || node_pos[ref_index[k + 1]] < 0;
+            if (run_start || run_end) is_junction[ref_index[k]] = 1;
+        }
+    }
+
+    // Walk every way, summing segment lengths between consecutive graph nodes
+    std::vector<SegmentEdge> segments;
+    #pragma omp parallel
+    {
+        std::vector<SegmentEdge> local_segments;
+        #pragma omp for schedule(dynamic, 256) nowait
+        for (size_t w = 0; w < way_count; ++w) {
+            int start = -1;
+            const OsmNode* previous = nullptr;
+            double length = 0.0;
+            for (size_t k = way_offsets[w]; k < way_offsets[w + 1]; ++k) {
+                int u = ref_index[k];
+                if (node_pos[u] < 0) { // Gap in the extract; the next run starts at a graph node
+                    start = -1;
+                    continue;
+                }
+                const OsmNode* current = &nodes[node_pos[u]];
+                if (start >= 0) {
+                    length += haversineDistance(previous->lat, previous->lon, current->lat, current->lon);
+                }
+                if (is_junction[u]) {
+                    if (start >= 0 && start != u) { // Loops back to the same node carry no route
+                        local_segments.push_back({ std::min(start, u), std::max(start, u), length });
+                    }
+                    start = u;
+                    length = 0.0;
+                }
+                previous = current;
+            }
+        }
+        #pragma omp critical(osm_segment_merge)
+        segments.insert(segments.end(), local_segments.begin(), local_segments.end());
+    }
+
+    // Parallel ways between the same two nodes: keep the shortest
+    std::sort(segments.begin(), segments.end());
+    segments.erase(std::unique(segments.begin(), segments.end(),
+                               [](const SegmentEdge& x, const SegmentEdge& y) { return x.a == y.a && x.b == y.b; }),
+                   segments.end());
+
+    // Sequential IDs, in OSM ID order, for the nodes that ended up on an edge
+    std::vector<int> graph_id(unique_count, -1);
+    for (const SegmentEdge& s : segments) graph_id[s.a] = graph_id[s.b] = 0;
+    network.nodes.clear();
+    for (size_t u = 0; u < unique_count; ++u) {
+        if (graph_id[u] < 0) continue;
+        graph_id[u] = static_cast<int>(network.nodes.size());
+        const OsmNode& node = nodes[node_pos[u]];
+        network.nodes.emplace_back(graph_id[u], node.lat, node.lon);
+    }
+    network.edges.resize(segments.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < segments.size(); ++i) {
+        network.edges[i] = Edge(graph_id[segments[i].a], graph_id[segments[i].b], segments[i].length_km);
+    }
+
+    qDebug() << "OSM import:" << nodes.size() << "nodes," << way_count << "highway ways ->"
+             << network.nodes.size() << "graph nodes," << network.edges.size() << "edges.";
+}
+
+} // namespace
+
+bool importOsmFile(const std::string& filepath, OsmRoadNetwork& network, std::string& error) {
+    QFile file(QString::fromStdString(filepath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "could not open " + filepath;
+        return false;
+    }
+
+    // XML starts with '<' (possibly after a byte order mark or whitespace); PBF with a length
+    const QByteArray head = file.peek(64);
+    bool is_xml = false;
+    for (int i = 0; i < head.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(head.constData()[i]);
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0xEF || c == 0xBB || c == 0xBF) continue;
+        is_xml = c == '<';
+        break;
+    }
+
+    std::vector<OsmBlock> blocks;
+    if (is_xml) {
+        blocks.resize(1);
+        if (!readXml(file, blocks[0])) {
+            error = blocks[0].error;
+            return false;
+        }
+    } else {
+        const MappedFile contents(file);
+        if (!readPbf(contents.bytes(), contents.size(), blocks, error)) return false;
+    }
+
+    buildNetwork(blocks, network);
+    if (network.nodes.empty()) {
+        error = "no routable highways found";
+        return false;
+    }
+    return true;
+}
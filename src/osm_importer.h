@@ -0,0 +1,25 @@
+#ifndef OSM_IMPORTER_H
+#define OSM_IMPORTER_H
+
+#include <vector>
+#include <string>
+
+#include "data_types.h"
+
+// Street graph read from an OpenStreetMap extract (see importOsmFile)
+struct OsmRoadNetwork {
+    std::vector<Node> nodes; // Junctions and dead ends, with sequential IDs from 0
+    std::vector<Edge> edges; // Street segments between two nodes; weight = length along the way (km)
+};
+
+// Imports the routable streets of a local OpenStreetMap extract, either XML (.osm) or PBF
+// (.osm.pbf; the format is detected from the content). PBF blocks are decoded in parallel.
+//
+// Only ways with a routable highway=* tag are kept. Chains of nodes used by a single way are
+// collapsed: graph nodes are way endpoints and nodes shared by several ways (or visited twice by
+// one), and each edge follows the way geometry between two of them. Ways are cut where the
+// extract lacks a referenced node. The graph is undirected, so oneway tags are ignored.
+// Returns false (with a message in 'error') if the file cannot be read or parsed.
+bool importOsmFile(const std::string& filepath, OsmRoadNetwork& network, std::string& error);
+
+#endif // OSM_IMPORTER_H
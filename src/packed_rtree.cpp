@@ -0,0 +1,185 @@
+#include "packed_rtree.h"
+#include "graph_snapshot.h"
+#include <algorithm> // For std::sort, std::min, std::max
+#include <cmath>     // For std::ceil, std::sqrt
+#include <limits>
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+namespace {
+
+constexpr size_t kParallelQueryLeaves = 64; // Fewer candidate leaves are scanned on the calling thread
+
+PackedRTree::Box emptyBox() {
+    const double inf = std::numeric_limits<double>::infinity();
+    return { inf, inf, -inf, -inf };
+}
+
+void extend(PackedRTree::Box& box, const PackedRTree::Box& other) {
+    box.min_lat = std::min(box.min_lat, other.min_lat);
+    box.min_lon = std::min(box.min_lon, other.min_lon);
+    box.max_lat = std::max(box.max_lat, other.max_lat);
+    box.max_lon = std::max(box.max_lon, other.max_lon);
+}
+
+} // namespace
+
+void PackedRTree::clear() {
+    order_.clear();
+    lats_.clear();
+    lons_.clear();
+    boxes_.clear();
+    level_offsets_.clear();
+}
+
+void PackedRTree::build(const std::vector<Node>& nodes) {
+    clear();
+    const size_t n = nodes.size();
+    if (n == 0) return;
+
+    // Sort-Tile-Recursive: slices of whole leaves by longitude, then latitude within each slice
+    order_.resize(n);
+    for (size_t i = 0; i < n; ++i) order_[i] = static_cast<int>(i);
+    std::sort(order_.begin(), order_.end(), [&nodes](int a, int b) {
+        return nodes[a].coords.lon < nodes[b].coords.lon;
+    });
+    const size_t leaf_count = (n + kNodeCapacity - 1) / kNodeCapacity;
+    const size_t slice_leaves = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(leaf_count))));
+    const size_t slice_size = slice_leaves * kNodeCapacity;
+    const size_t slice_count = (n + slice_size - 1) / slice_size;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t s = 0; s < slice_count; ++s) {
+        auto begin = order_.begin() + s * slice_size;
+        auto end = order_.begin() + std::min(n, (s + 1) * slice_size);
+        std::sort(begin, end, [&nodes](int a, int b) { return nodes[a].coords.lat < nodes[b].coords.lat; });
+    }
+
+    lats_.resize(n);
+    lons_.resize(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        lats_[i] = nodes[order_[i]].coords.lat;
+        lons_[i] = nodes[order_[i]].coords.lon;
+    }
+
+    // Leaf boxes
+    boxes_.assign(leaf_count, emptyBox());
+    #pragma omp parallel for
+    for (size_t leaf = 0; leaf < leaf_count; ++leaf) {
+        Box box = emptyBox();
+        for (size_t i = leaf * kNodeCapacity; i < std::min(n, (leaf + 1) * kNodeCapacity); ++i) {
+            extend(box, { lats_[i], lons_[i], lats_[i], lons_[i] });
+        }
+        boxes_[leaf] = box;
+    }
+
+    // Upper levels until a single root remains
+    level_offsets_ = { 0, leaf_count };
+    while (level_offsets_.back() - level_offsets_[level_offsets_.size() - 2] > 1) {
+        size_t child_begin = level_offsets_[level_offsets_.size() - 2];
+        size_t child_end = level_offsets_.back();
+        size_t parent_count = (child_end - child_begin + kNodeCapacity - 1) / kNodeCapacity;
+        for (size_t p = 0; p < parent_count; ++p) {
+            Box box = emptyBox();
+            for (size_t c = child_begin + p * kNodeCapacity; c < std::min(child_end, child_begin + (p + 1) * kNodeCapacity); ++c) {
+                extend(box, boxes_[c]);
+            }
+            boxes_.push_back(box);
+        }
+        level_offsets_.push_back(boxes_.size());
+    }
+    qDebug() << "PackedRTree: Built R-tree over" << n << "nodes with" << levelCount() << "levels.";
+}
+
+void PackedRTree::findLeaves(const Box& box, std::vector<size_t>& leaves, std::vector<char>& inside) const {
+    // Entries are (level, position within level)
+    std::vector<std::pair<size_t, size_t>> stack;
+    stack.push_back({ levelCount() - 1, 0 });
+    while (!stack.empty()) {
+        auto [level, pos] = stack.back();
+        stack.pop_back();
+        const Box& node_box = boxes_[level_offsets_[level] + pos];
+        if (!box.intersects(node_box)) continue;
+        if (level == 0) {
+            leaves.push_back(pos);
+            inside.push_back(box.contains(node_box) ? 1 : 0);
+            continue;
+        }
+        size_t child_level_size = level_offsets_[level] - level_offsets_[level - 1];
+        size_t first = pos * kNodeCapacity;
+        size_t last = std::min(child_level_size, first + kNodeCapacity);
+        for (size_t c = first; c < last; ++c) {
+            stack.push_back({ level - 1, c });
+        }
+    }
+}
+
+std::vector<int> PackedRTree::query(const Box& box) const {
+    std::vector<int> hits;
+    if (order_.empty()) return hits;
+
+    std::vector<size_t> leaves;
+    std::vector<char> inside;
+    findLeaves(box, leaves, inside);
+
+    const size_t n = order_.size();
+    #pragma omp parallel if (leaves.size() >= kParallelQueryLeaves)
+    {
+        std::vector<int> local_hits; // Thread-local, merged once per thread
+        #pragma omp for nowait
+        for (size_t l = 0; l < leaves.size(); ++l) {
+            size_t begin = leaves[l] * kNodeCapacity;
+            size_t end = std::min(n, begin + kNodeCapacity);
+            for (size_t i = begin; i < end; ++i) {
+                if (inside[l] || box.contains(lats_[i], lons_[i])) {
+                    local_hits.push_back(order_[i]);
+                }
+            }
+        }
+        #pragma omp critical(rtree_hit_merge)
+        hits.insert(hits.end(), local_hits.begin(), local_hits.end());
+    }
+    return hits;
+}
+
+void PackedRTree::save(SnapshotWriter& writer) const {
+    writer.writeArray(order_);
+    writer.writeArray(lats_);
+    writer.writeArray(lons_);
+    writer.writeArray(boxes_);
+    std::vector<uint64_t> offsets(level_offsets_.begin(), level_offsets_.end());
+    writer.writeArray(offsets);
+}
+
+bool PackedRTree::load(SnapshotReader& reader, size_t node_count) {
+    clear();
+    std::vector<uint64_t> offsets;
+    reader.readArray(order_);
+    reader.readArray(lats_);
+    reader.readArray(lons_);
+    reader.readArray(boxes_);
+    reader.readArray(offsets);
+    level_offsets_.assign(offsets.begin(), offsets.end());
+
+    // Levels must tile boxes_ from the leaves up to a single root
+    const size_t n = order_.size();
+    const size_t leaf_count = (n + kNodeCapacity - 1) / kNodeCapacity;
+    bool valid = reader.ok() && n == node_count && lats_.size() == n && lons_.size() == n;
+    if (valid && n > 0) {
+        valid = level_offsets_.size() >= 2 && level_offsets_[0] == 0 && level_offsets_[1] == leaf_count &&
+                level_offsets_.back() == boxes_.size() &&
+                level_offsets_.back() - level_offsets_[level_offsets_.size() - 2] == 1;
+        for (size_t l = 1; valid && l + 1 < level_offsets_.size(); ++l) {
+            size_t child_count = level_offsets_[l] - level_offsets_[l - 1];
+            valid = level_offsets_[l + 1] - level_offsets_[l] == (child_count + kNodeCapacity - 1) / kNodeCapacity;
+        }
+    } else if (valid) {
+        valid = boxes_.empty();
+        level_offsets_.clear();
+    }
+    for (size_t i = 0; valid && i < n; ++i) {
+        valid = order_[i] >= 0 && static_cast<size_t>(order_[i]) < node_count;
+    }
+    if (!valid) clear();
+    return valid;
+}
@@ -0,0 +1,64 @@
+#ifndef PACKED_RTREE_H
+#define PACKED_RTREE_H
+
+#include <vector>
+#include <cstddef>
+
+#include "data_types.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Static R-tree over node coordinates for region queries (area obstacles).
+//
+// Bulk loaded with Sort-Tile-Recursive packing: points are sorted into vertical slices by
+// longitude, each slice by latitude, and consecutive runs of kNodeCapacity points form the
+// leaves. Upper levels group consecutive boxes of the level below, so the whole tree lives in
+// flat arrays without child pointers. Every box is full except the last one of each level.
+class PackedRTree {
+public:
+    struct Box {
+        double min_lat, min_lon, max_lat, max_lon;
+
+        bool contains(double lat, double lon) const {
+            return lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon;
+        }
+        bool contains(const Box& other) const {
+            return other.min_lat >= min_lat && other.max_lat <= max_lat &&
+                   other.min_lon >= min_lon && other.max_lon <= max_lon;
+        }
+        bool intersects(const Box& other) const {
+            return other.min_lat <= max_lat && other.max_lat >= min_lat &&
+                   other.min_lon <= max_lon && other.max_lon >= min_lon;
+        }
+    };
+
+    // Builds the tree over 'nodes'; results refer to positions (dense indices) in that vector
+    void build(const std::vector<Node>& nodes);
+    void clear();
+    bool empty() const { return order_.empty(); }
+    Box bounds() const { return boxes_.empty() ? Box{ 0, 0, 0, 0 } : boxes_.back(); } // Root box
+
+    // Dense indices of all nodes inside 'box' (bounds inclusive), in no particular order.
+    // Costs O(log n + hits); large results are gathered in parallel.
+    std::vector<int> query(const Box& box) const;
+
+    // Graph snapshot sections; load() returns false (leaving the tree empty) if the data is
+    // inconsistent or does not hold exactly 'node_count' nodes
+    void save(SnapshotWriter& writer) const;
+    bool load(SnapshotReader& reader, size_t node_count);
+
+private:
+    static constexpr size_t kNodeCapacity = 16;
+
+    // Leaves whose box intersects 'box'; 'inside' tells whether the leaf box lies entirely within it
+    void findLeaves(const Box& box, std::vector<size_t>& leaves, std::vector<char>& inside) const;
+    size_t levelCount() const { return level_offsets_.size() - 1; }
+
+    std::vector<int> order_;            // Dense node index of each slot, in STR order
+    std::vector<double> lats_, lons_;   // Coordinates of each slot
+    std::vector<Box> boxes_;            // All tree nodes, level by level, leaves first
+    std::vector<size_t> level_offsets_; // Level l occupies boxes_[level_offsets_[l], level_offsets_[l + 1])
+};
+
+#endif // PACKED_RTREE_H
@@ -0,0 +1,90 @@
+#ifndef ROUTE_CACHE_H
+#define ROUTE_CACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Thread-safe LRU cache of computed routes, keyed by (origin ID, destination ID, graph version).
+// The graph version changes whenever obstacles or the graph itself change, so entries never
+// need explicit invalidation: stale ones simply stop matching and age out.
+class RouteCache {
+public:
+    explicit RouteCache(size_t capacity = 1024) : capacity_(capacity) {}
+
+    // Returns true and fills 'path' (possibly empty for "no route") on a hit
+    bool lookup(int origin_id, int dest_id, uint64_t graph_version, std::vector<int>& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(Key{origin_id, dest_id, graph_version});
+        if (it == index_.end()) {
+            return false;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second); // Mark as most recently used
+        path = it->second->path;
+        return true;
+    }
+
+    void insert(int origin_id, int dest_id, uint64_t graph_version, const std::vector<int>& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (graph_version > newest_version_) {
+            // Versions only grow, so everything cached so far is unreachable now
+            entries_.clear();
+            index_.clear();
+            newest_version_ = graph_version;
+        } else if (graph_version < newest_version_) {
+            return; // Computed against a graph state that is already gone
+        }
+        Key key{origin_id, dest_id, graph_version};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            it->second->path = path;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        entries_.push_front(Entry{key, path});
+        index_[key] = entries_.begin();
+        if (entries_.size() > capacity_) {
+            index_.erase(entries_.back().key);
+            entries_.pop_back();
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        index_.clear();
+    }
+
+private:
+    struct Key {
+        int origin_id;
+        int dest_id;
+        uint64_t version;
+        bool operator==(const Key& other) const {
+            return origin_id == other.origin_id && dest_id == other.dest_id && version == other.version;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(k.origin_id)) << 32) |
+                         static_cast<uint32_t>(k.dest_id);
+            h ^= k.version + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+    struct Entry {
+        Key key;
+        std::vector<int> path;
+    };
+
+    size_t capacity_;
+    uint64_t newest_version_ = 0;
+    std::list<Entry> entries_; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    std::mutex mutex_;
+};
+
+#endif // ROUTE_CACHE_H
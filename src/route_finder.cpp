@@ -1,5 +1,5 @@
 #include "route_finder.h"
-#include <algorithm> // For std::reverse
+#include <algorithm> // For std::reverse, std::push_heap, std::pop_heap
 #include <cmath>     // For std::sqrt, std::pow in heuristic
 #include <omp.h>     // For OpenMP
 
@@ -9,16 +9,19 @@
 // For this example, let's assume it's copied or globally available.
 double haversineDistance(double lat1, double lon1, double lat2, double lon2); // Forward declaration
 
-double RouteFinder::calculateHeuristic(const Node& current, const Node& goal) const {
-    // Using Haversine distance as heuristic for geographical coordinates
-    return haversineDistance(current.coords.lat, current.coords.lon,
-                             goal.coords.lat, goal.coords.lon);
-}
-
-
-std::vector<int> RouteFinder::findRoute(const GraphManager& graph_manager, int origin_id, int dest_id) {
+std::vector<int> RouteFinder::findRoute(const GraphManager& graph_manager, int origin_id, int dest_id,
+                                        RoutingAlgorithm algorithm) {
     qDebug() << "RouteFinder: Searching route from" << origin_id << "to" << dest_id;
 
+    // Read the version before any graph state: a result computed while the graph changes is then
+    // filed under the old version and never served for the new one
+    uint64_t version = graph_manager.getGraphVersion();
+    std::vector<int> cached_path;
+    if (route_cache_.lookup(origin_id, dest_id, version, cached_path)) {
+        qDebug() << "RouteFinder: Route served from cache (" << cached_path.size() << "nodes).";
+        return cached_path;
+    }
+
     // Check if origin or destination are obstacles
     if (graph_manager.isObstacle(origin_id)) {
         qWarning() << "Origin node" << origin_id << "is an obstacle. Cannot find route.";
@@ -29,69 +32,446 @@ std::vector<int> RouteFinder::findRoute(const GraphManager& graph_manager, int o
         return {};
     }
 
+    QueryContext context = prepareQuery(graph_manager, algorithm);
+    if (!context.adjacency && !context.compressed) {
+        qWarning() << "RouteFinder: Graph not triangulated yet.";
+        return {};
+    }
+
+    std::vector<int> path;
+    size_t settled = 0;
+    if (context.algorithm == RoutingAlgorithm::Incremental) {
+        std::lock_guard<std::mutex> lock(incremental_mutex_);
+        int origin = graph_manager.getNodeIndex(origin_id);
+        int dest = graph_manager.getNodeIndex(dest_id);
+        if (origin >= 0 && dest >= 0) {
+            path = incremental_router_.route(graph_manager, context.adjacency, origin, dest, version);
+            for (int& index : path) {
+                index = graph_manager.getAllNodes()[index].id; // Dense index to node ID, in place
+            }
+            settled = incremental_router_.lastExpansions();
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(workspace_mutex_);
+        path = runQuery(graph_manager, context, origin_id, dest_id, workspace_, reverse_workspace_);
+        settled = workspace_.settled + reverse_workspace_.settled;
+    }
+    if (path.empty()) {
+        qWarning() << "RouteFinder: No route found from" << origin_id << "to" << dest_id;
+    } else {
+        qDebug() << "RouteFinder: Route found with" << path.size() << "nodes," << settled << "nodes settled.";
+    }
+    route_cache_.insert(origin_id, dest_id, version, path);
+    return path;
+}
+
+std::vector<std::vector<int>> RouteFinder::findRoutes(const GraphManager& graph_manager,
+                                                      const std::vector<std::pair<int, int>>& queries,
+                                                      RoutingAlgorithm algorithm) {
+    std::vector<std::vector<int>> results(queries.size());
+    QueryContext context = prepareQuery(graph_manager, algorithm);
+    if ((!context.adjacency && !context.compressed) || queries.empty()) {
+        return results;
+    }
+    qDebug() << "RouteFinder: Running batch of" << queries.size() << "route queries.";
+
+    std::lock_guard<std::mutex> lock(parallel_mutex_);
+    std::vector<ThreadWorkspaces>& workspaces = parallelWorkspaces();
+
+    // Small dynamic chunks: route costs vary wildly, so idle threads keep pulling work
+    size_t found = 0;
+    #pragma omp parallel for schedule(dynamic, 4) reduction(+:found)
+    for (size_t i = 0; i < queries.size(); ++i) {
+        ThreadWorkspaces& ws = workspaces[omp_get_thread_num()];
+        results[i] = runQuery(graph_manager, context, queries[i].first, queries[i].second, ws.forward, ws.backward);
+        if (!results[i].empty()) found++;
+    }
+
+    qDebug() << "RouteFinder: Batch done," << found << "of" << queries.size() << "routes found.";
+    return results;
+}
+
+RouteFinder::QueryContext RouteFinder::prepareQuery(const GraphManager& graph_manager, RoutingAlgorithm algorithm) const {
+    QueryContext context;
+    context.algorithm = algorithm;
+    context.adjacency = graph_manager.getAdjacency();
+    context.compressed = graph_manager.getCompressedAdjacency();
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        context.hierarchy = hierarchy_;
+        context.landmarks = landmarks_;
+    }
+
+    if (algorithm == RoutingAlgorithm::ContractionHierarchies) {
+        // The hierarchy encodes obstacle-free shortest paths of one specific adjacency snapshot
+        // (the override-free base snapshot, which is what getAdjacency() returns without overrides)
+        if (graph_manager.hasEdgeOverrides()) {
+            qDebug() << "RouteFinder: Edge weight overrides are set, using A* instead of the contraction hierarchy.";
+            context.algorithm = RoutingAlgorithm::AStar;
+        } else if (!context.hierarchy || !context.hierarchy->isBuiltFor(context.adjacency)) {
+            qWarning() << "RouteFinder: Contraction hierarchy not built for the current graph, using A*.";
+            context.algorithm = RoutingAlgorithm::AStar;
+        } else if (graph_manager.hasObstacles()) {
+            qDebug() << "RouteFinder: Obstacles are set, using A* instead of the contraction hierarchy.";
+            context.algorithm = RoutingAlgorithm::AStar;
+        }
+    }
+    if (algorithm == RoutingAlgorithm::Incremental && !context.adjacency) {
+        // The incremental search keeps its state over a CSR adjacency
+        qDebug() << "RouteFinder: Low-memory adjacency, using A* instead of the incremental search.";
+        context.algorithm = RoutingAlgorithm::AStar;
+    }
+    if (algorithm == RoutingAlgorithm::ALT &&
+        (!context.landmarks || !context.landmarks->isValidFor(context.adjacency, graph_manager.getGraphVersion()))) {
+        qDebug() << "RouteFinder: Landmark tables are out of date, using the haversine heuristic only.";
+        context.algorithm = RoutingAlgorithm::AStar;
+    }
+    if (context.algorithm != RoutingAlgorithm::ContractionHierarchies) context.hierarchy.reset();
+    if (context.algorithm != RoutingAlgorithm::ALT) context.landmarks.reset();
+    return context;
+}
+
+std::vector<int> RouteFinder::runQuery(const GraphManager& graph_manager, const QueryContext& context,
+                                       int origin_id, int dest_id,
+                                       SearchWorkspace& forward, SearchWorkspace& backward) const {
     const auto& all_nodes = graph_manager.getAllNodes();
-    std::unordered_map<int, double> g_score; // Actual cost from origin to current node
-    std::unordered_map<int, int> came_from; // Parent node in optimal path
-    std::priority_queue<NodeScore, std::vector<NodeScore>, std::greater<NodeScore>> open_set;
+    const ObstacleBitset& blocked = graph_manager.getObstacles();
+    int origin = graph_manager.getNodeIndex(origin_id);
+    int dest = graph_manager.getNodeIndex(dest_id);
+    forward.settled = backward.settled = 0;
+    if (origin < 0 || dest < 0 || blocked.test(origin) || blocked.test(dest)) {
+        return {};
+    }
+
+    // CH and ALT only run on a CSR adjacency (prepareQuery() falls back to A* otherwise)
+    auto search = [&](const auto& graph) -> std::vector<int> {
+        switch (context.algorithm) {
+            case RoutingAlgorithm::BidirectionalAStar:
+                return searchBidirectional(graph_manager.getCoordinates(), graph, blocked, origin, dest, forward, backward);
+            case RoutingAlgorithm::ContractionHierarchies:
+                return context.hierarchy->query(origin, dest, forward, backward);
+            case RoutingAlgorithm::ALT:
+                return searchAStar(graph_manager.getCoordinates(), graph, blocked, origin, dest, forward, context.landmarks.get());
+            case RoutingAlgorithm::Incremental: // Its search state belongs to findRoute(); batches run plain A*
+            case RoutingAlgorithm::AStar:
+            default:
+                return searchAStar(graph_manager.getCoordinates(), graph, blocked, origin, dest, forward, nullptr);
+        }
+    };
+    std::vector<int> indices = context.adjacency ? search(*context.adjacency) : search(*context.compressed);
 
-    // Initialize scores with infinity
-    for (const auto& node : all_nodes) {
-        g_score[node.id] = std::numeric_limits<double>::infinity();
+    // Dense indices back to node IDs
+    std::vector<int> path;
+    path.reserve(indices.size());
+    for (int index : indices) {
+        path.push_back(all_nodes[index].id);
     }
+    return path;
+}
+
+template <typename Graph>
+std::vector<int> RouteFinder::searchAStar(const CoordinateArrays& coords, const Graph& graph,
+                                          const ObstacleBitset& blocked, int origin, int dest, SearchWorkspace& workspace,
+                                          const LandmarkIndex* landmarks) const {
+    // Both bounds are consistent, so their maximum is too
+    auto landmarkBound = [&](int index, double h) {
+        return landmarks ? std::max(h, landmarks->lowerBound(index, dest)) : h;
+    };
+
+    // g-scores and parents are indexed by dense node index; reset() is O(1)
+    workspace.reset(graph.nodeCount());
+    std::vector<NodeScore>& open_set = workspace.open_set;
+    auto push = [&open_set](int index, double f_score) {
+        open_set.push_back({index, f_score});
+        std::push_heap(open_set.begin(), open_set.end(), std::greater<NodeScore>());
+    };
 
-    g_score[origin_id] = 0;
-    double h_score_origin = calculateHeuristic(graph_manager.getNode(origin_id), graph_manager.getNode(dest_id));
-    open_set.push({origin_id, h_score_origin}); // f_score = g_score + h_score
+    workspace.update(origin, 0.0, -1);
+    push(origin, landmarkBound(origin, coords.distanceKm(origin, dest))); // f_score = g_score + h_score
 
     while (!open_set.empty()) {
-        int current_id = open_set.top().node_id;
-        open_set.pop();
+        std::pop_heap(open_set.begin(), open_set.end(), std::greater<NodeScore>());
+        int current = open_set.back().node_index;
+        open_set.pop_back();
 
-        if (current_id == dest_id) {
+        // Skip stale heap entries; with a consistent heuristic a node is expanded at most once
+        if (workspace.isClosed(current)) {
+            continue;
+        }
+        workspace.close(current);
+
+        if (current == dest) {
             // Reconstruct path
             std::vector<int> path;
-            int temp_id = current_id;
-            while (temp_id != origin_id) {
-                path.push_back(temp_id);
-                temp_id = came_from[temp_id];
+            for (int temp = current; temp != -1; temp = workspace.parent(temp)) {
+                path.push_back(temp);
             }
-            path.push_back(origin_id);
             std::reverse(path.begin(), path.end());
-            qDebug() << "RouteFinder: Route found with" << path.size() << "nodes.";
             return path;
         }
 
-        const Node& current_node = graph_manager.getNode(current_id);
-        
-        // Parallelize neighbor processing
-        #pragma omp parallel for
-        for (size_t i = 0; i < current_node.neighbors.size(); ++i) {
-            int neighbor_id = current_node.neighbors[i];
-            const Node& neighbor_node = graph_manager.getNode(neighbor_id);
-
+        // Neighbors are a contiguous slice of the CSR arrays (or one encoded row). A node has
+        // only a handful of neighbors, so this loop is run sequentially; the heuristics of the
+        // improved ones are then computed in one call to the coordinate kernel.
+        double current_g = workspace.gScore(current);
+        workspace.batch_nodes.clear();
+        workspace.batch_g.clear();
+        graph.forEachNeighbor(current, [&](int neighbor, double weight) {
             // Skip obstacle nodes
-            if (graph_manager.isObstacle(neighbor_id)) {
-                continue;
+            if (blocked.test(neighbor) || workspace.isClosed(neighbor)) {
+                return;
             }
 
             // Calculate tentative_g_score (cost from origin to neighbor via current)
-            double dist = haversineDistance(current_node.coords.lat, current_node.coords.lon,
-                                            neighbor_node.coords.lat, neighbor_node.coords.lon);
-            double tentative_g_score = g_score[current_id] + dist;
-
-            // Using critical section to protect shared g_score and came_from maps
-            #pragma omp critical(astar_update)
-            {
-                if (tentative_g_score < g_score[neighbor_id]) {
-                    came_from[neighbor_id] = current_id;
-                    g_score[neighbor_id] = tentative_g_score;
-                    double f_score = tentative_g_score + calculateHeuristic(neighbor_node, graph_manager.getNode(dest_id));
-                    open_set.push({neighbor_id, f_score});
-                }
+            double tentative_g_score = current_g + weight;
+            if (tentative_g_score < workspace.gScore(neighbor)) {
+                workspace.batch_nodes.push_back(neighbor);
+                workspace.batch_g.push_back(tentative_g_score);
+            }
+        });
+
+        const size_t improved = workspace.batch_nodes.size();
+        workspace.batch_h.resize(improved);
+        coords.distancesKm(dest, workspace.batch_nodes.data(), improved, workspace.batch_h.data());
+        for (size_t j = 0; j < improved; ++j) {
+            int neighbor = workspace.batch_nodes[j];
+            double h = landmarkBound(neighbor, workspace.batch_h[j]);
+            if (h == std::numeric_limits<double>::infinity()) {
+                continue; // Landmarks prove the destination is unreachable from here
+            }
+            if (workspace.batch_g[j] < workspace.gScore(neighbor)) { // Parallel edges: keep the best
+                workspace.update(neighbor, workspace.batch_g[j], current);
+                push(neighbor, workspace.batch_g[j] + h);
             }
         }
     }
 
-    qWarning() << "RouteFinder: No route found from" << origin_id << "to" << dest_id;
     return {}; // No path found
 }
+
+template <typename Graph>
+std::vector<int> RouteFinder::searchBidirectional(const CoordinateArrays& coords, const Graph& graph,
+                                                  const ObstacleBitset& blocked, int origin, int dest,
+                                                  SearchWorkspace& forward, SearchWorkspace& backward) const {
+    if (origin == dest) {
+        return { origin };
+    }
+
+    // Forward potential; the backward search uses its negation
+    auto potential = [&](int index) {
+        return 0.5 * (coords.distanceKm(index, dest) - coords.distanceKm(origin, index));
+    };
+
+    forward.reset(graph.nodeCount());
+    backward.reset(graph.nodeCount());
+    auto push = [](SearchWorkspace& ws, int index, double key) {
+        ws.open_set.push_back({index, key});
+        std::push_heap(ws.open_set.begin(), ws.open_set.end(), std::greater<NodeScore>());
+    };
+    // Drops already-expanded entries so open_set.front() is a live minimum (or the heap is empty)
+    auto prune = [](SearchWorkspace& ws) {
+        while (!ws.open_set.empty() && ws.isClosed(ws.open_set.front().node_index)) {
+            std::pop_heap(ws.open_set.begin(), ws.open_set.end(), std::greater<NodeScore>());
+            ws.open_set.pop_back();
+        }
+    };
+
+    forward.update(origin, 0.0, -1);
+    push(forward, origin, potential(origin));
+    backward.update(dest, 0.0, -1);
+    push(backward, dest, -potential(dest));
+
+    double best_cost = std::numeric_limits<double>::infinity(); // mu
+    int meeting_node = -1;
+
+    while (true) {
+        prune(forward);
+        prune(backward);
+        if (forward.open_set.empty() || backward.open_set.empty()) {
+            break;
+        }
+        double top_forward = forward.open_set.front().f_score;
+        double top_backward = backward.open_set.front().f_score;
+        if (top_forward + top_backward >= best_cost) {
+            break; // No path through an unsettled node can beat the current best
+        }
+
+        // Expand the side with the smaller key
+        bool is_forward = top_forward <= top_backward;
+        SearchWorkspace& self = is_forward ? forward : backward;
+        const SearchWorkspace& other = is_forward ? backward : forward;
+        const double sign = is_forward ? 1.0 : -1.0;
+
+        std::pop_heap(self.open_set.begin(), self.open_set.end(), std::greater<NodeScore>());
+        int current = self.open_set.back().node_index;
+        self.open_set.pop_back();
+        self.close(current);
+
+        double current_g = self.gScore(current);
+        graph.forEachNeighbor(current, [&](int neighbor, double weight) {
+            if (blocked.test(neighbor) || self.isClosed(neighbor)) {
+                return;
+            }
+
+            double tentative_g_score = current_g + weight;
+            if (tentative_g_score < self.gScore(neighbor)) {
+                self.update(neighbor, tentative_g_score, current);
+                push(self, neighbor, tentative_g_score + sign * potential(neighbor));
+            }
+
+            // Path candidate through this edge if the other side has reached the neighbor
+            double through = tentative_g_score + other.gScore(neighbor);
+            if (through < best_cost) {
+                best_cost = through;
+                meeting_node = neighbor;
+            }
+        });
+    }
+
+    if (meeting_node == -1) {
+        return {};
+    }
+
+    // origin -> meeting node from the forward tree, then meeting node -> dest from the backward tree
+    std::vector<int> path;
+    for (int temp = meeting_node; temp != -1; temp = forward.parent(temp)) {
+        path.push_back(temp);
+    }
+    std::reverse(path.begin(), path.end());
+    for (int temp = backward.parent(meeting_node); temp != -1; temp = backward.parent(temp)) {
+        path.push_back(temp);
+    }
+    return path;
+}
+
+void RouteFinder::buildContractionHierarchy(const GraphManager& graph_manager) {
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+    hierarchy->build(graph_manager.getBaseAdjacency());
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    hierarchy_ = hierarchy;
+}
+
+void RouteFinder::rebuildLandmarks(const GraphManager& graph_manager, size_t landmark_count) {
+    // Read the version first: if the graph changes while we copy, the tables come out tagged
+    // with an older version, are never used, and the rebuild triggered by that change replaces them
+    uint64_t version = graph_manager.getGraphVersion();
+    std::shared_ptr<const CsrAdjacency> adjacency = graph_manager.getAdjacency();
+    if (!adjacency) {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        landmarks_.reset(); // Not triangulated yet, or low-memory mode
+        return;
+    }
+    CoordinateArrays coords;
+    ObstacleBitset blocked;
+    graph_manager.copyNodeState(coords, blocked); // Consistent with a load running on another thread
+
+    auto landmarks = std::make_shared<LandmarkIndex>();
+    landmarks->build(adjacency, coords, blocked, landmark_count, version);
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    landmarks_ = landmarks;
+}
+
+std::vector<RouteFinder::ThreadWorkspaces>& RouteFinder::parallelWorkspaces() {
+    size_t threads = static_cast<size_t>(omp_get_max_threads());
+    if (parallel_workspaces_.size() < threads) {
+        parallel_workspaces_.resize(threads);
+    }
+    return parallel_workspaces_;
+}
+
+DistanceMatrix RouteFinder::computeDistanceMatrix(const GraphManager& graph_manager, const std::vector<int>& source_ids,
+                                                  const std::vector<int>& target_ids, bool with_paths) {
+    DistanceMatrix matrix;
+    matrix.source_ids = source_ids;
+    matrix.target_ids = target_ids;
+    const size_t rows = source_ids.size();
+    const size_t cols = target_ids.size();
+    matrix.distances.assign(rows * cols, std::numeric_limits<double>::infinity());
+    if (with_paths) {
+        matrix.paths.assign(rows * cols, std::vector<int>());
+    }
+
+    const auto& all_nodes = graph_manager.getAllNodes();
+    const ObstacleBitset& blocked = graph_manager.getObstacles();
+    std::shared_ptr<const CsrAdjacency> adjacency = graph_manager.getAdjacency();
+    std::shared_ptr<const CompressedAdjacency> compressed = graph_manager.getCompressedAdjacency();
+    if ((!adjacency && !compressed) || rows == 0 || cols == 0) {
+        return matrix;
+    }
+    const size_t node_count = adjacency ? adjacency->nodeCount() : compressed->nodeCount();
+    auto forEachNeighbor = [&](int index, const auto& f) {
+        if (adjacency) adjacency->forEachNeighbor(index, f);
+        else compressed->forEachNeighbor(index, f);
+    };
+    qDebug() << "RouteFinder: Computing" << rows << "x" << cols << "distance matrix.";
+
+    // Dense target indices (-1 for unknown or blocked targets) and a membership mask
+    std::vector<int> target_index(cols);
+    std::vector<char> is_target(node_count, 0);
+    size_t distinct_targets = 0;
+    for (size_t j = 0; j < cols; ++j) {
+        int index = graph_manager.getNodeIndex(target_ids[j]);
+        if (index >= 0 && blocked.test(index)) {
+            index = -1;
+        }
+        target_index[j] = index;
+        if (index >= 0 && !is_target[index]) {
+            is_target[index] = 1;
+            distinct_targets++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(parallel_mutex_);
+    std::vector<ThreadWorkspaces>& workspaces = parallelWorkspaces();
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < rows; ++i) {
+        SearchWorkspace& ws = workspaces[omp_get_thread_num()].forward;
+        int origin = graph_manager.getNodeIndex(source_ids[i]);
+        if (origin < 0 || blocked.test(origin)) {
+            continue;
+        }
+
+        // One-to-all Dijkstra, cut off once every target is settled
+        ws.reset(node_count);
+        auto& heap = ws.open_set;
+        ws.update(origin, 0.0, -1);
+        heap.push_back({origin, 0.0});
+        size_t remaining = distinct_targets;
+        while (!heap.empty() && remaining > 0) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<NodeScore>());
+            int current = heap.back().node_index;
+            heap.pop_back();
+            if (ws.isClosed(current)) continue;
+            ws.close(current);
+            if (is_target[current]) remaining--;
+
+            double current_g = ws.gScore(current);
+            forEachNeighbor(current, [&](int neighbor, double weight) {
+                if (blocked.test(neighbor) || ws.isClosed(neighbor)) return;
+                double g = current_g + weight;
+                if (g < ws.gScore(neighbor)) {
+                    ws.update(neighbor, g, current);
+                    heap.push_back({neighbor, g});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<NodeScore>());
+                }
+            });
+        }
+
+        // Read the row out of the search tree
+        for (size_t j = 0; j < cols; ++j) {
+            int target = target_index[j];
+            if (target < 0 || !ws.isClosed(target)) continue;
+            matrix.distances[i * cols + j] = ws.gScore(target);
+            if (with_paths) {
+                std::vector<int>& path = matrix.paths[i * cols + j];
+                for (int temp = target; temp != -1; temp = ws.parent(temp)) {
+                    path.push_back(all_nodes[temp].id);
+                }
+                std::reverse(path.begin(), path.end());
+            }
+        }
+    }
+
+    return matrix;
+}
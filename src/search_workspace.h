@@ -0,0 +1,75 @@
+#ifndef SEARCH_WORKSPACE_H
+#define SEARCH_WORKSPACE_H
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Entry of the A* open set (min-heap on f_score)
+struct NodeScore {
+    int node_index;  // Dense node index (see CsrAdjacency)
+    double f_score;  // g_score + heuristic
+
+    bool operator>(const NodeScore& other) const { return f_score > other.f_score; }
+};
+
+// Reusable search state indexed by dense node index.
+// Every entry carries the generation it was written in; entries from older generations read as
+// "unvisited", so reset() is O(1) and a query only pays for the nodes it actually touches.
+class SearchWorkspace {
+public:
+    // Prepares the workspace for a new search over a graph with 'node_count' nodes
+    void reset(size_t node_count) {
+        if (entries_.size() != node_count) {
+            entries_.assign(node_count, Entry());
+            generation_ = 0;
+        }
+        if (++generation_ == 0) { // Wrapped around: old stamps could alias, wipe them once
+            for (auto& e : entries_) e.stamp = e.closed_stamp = 0;
+            generation_ = 1;
+        }
+        open_set.clear();
+        settled = 0;
+    }
+
+    double gScore(int index) const {
+        const Entry& e = entries_[index];
+        return e.stamp == generation_ ? e.g : std::numeric_limits<double>::infinity();
+    }
+    int parent(int index) const {
+        const Entry& e = entries_[index];
+        return e.stamp == generation_ ? e.parent : -1;
+    }
+    void update(int index, double g, int parent) {
+        Entry& e = entries_[index];
+        e.g = g;
+        e.parent = parent;
+        e.stamp = generation_;
+    }
+    bool isClosed(int index) const { return entries_[index].closed_stamp == generation_; }
+    void close(int index) {
+        entries_[index].closed_stamp = generation_;
+        ++settled;
+    }
+
+    // Binary min-heap storage, kept between searches to avoid reallocating
+    std::vector<NodeScore> open_set;
+    // Improved neighbors of the node being expanded, whose heuristics are evaluated in one batch
+    std::vector<int> batch_nodes;
+    std::vector<double> batch_g;
+    std::vector<double> batch_h;
+    size_t settled = 0; // Nodes expanded since the last reset(), for diagnostics
+
+private:
+    struct Entry {
+        double g = std::numeric_limits<double>::infinity();
+        int parent = -1;
+        uint32_t stamp = 0;        // Generation in which g/parent were written
+        uint32_t closed_stamp = 0; // Generation in which the node was expanded
+    };
+    std::vector<Entry> entries_;
+    uint32_t generation_ = 0;
+};
+
+#endif // SEARCH_WORKSPACE_H
@@ -0,0 +1,256 @@
+#include "spatial_index.h"
+#include "graph_snapshot.h"
+#include <algorithm> // For std::nth_element, std::push_heap, std::pop_heap, std::sort_heap
+#include <cmath>
+#include <limits>
+#include <QDebug>
+#include <omp.h>     // For OpenMP
+
+namespace {
+
+constexpr double kEarthRadiusKm = 6371.0; // Same radius as haversineDistance
+constexpr size_t kParallelBuildThreshold = 1 << 15; // Smaller ranges are built by a single task
+
+struct BuildPoint {
+    double c[3];
+    int index;
+};
+
+// Recursively arranges points[lo, hi) into implicit k-d tree order, splitting on the axis
+// with the largest extent
+void buildRange(std::vector<BuildPoint>& points, std::vector<unsigned char>& split_dim,
+                size_t lo, size_t hi, size_t leaf_size) {
+    if (hi - lo <= leaf_size) return;
+
+    double min_c[3] = { points[lo].c[0], points[lo].c[1], points[lo].c[2] };
+    double max_c[3] = { min_c[0], min_c[1], min_c[2] };
+    for (size_t i = lo + 1; i < hi; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            min_c[d] = std::min(min_c[d], points[i].c[d]);
+            max_c[d] = std::max(max_c[d], points[i].c[d]);
+        }
+    }
+    int dim = 0;
+    for (int d = 1; d < 3; ++d) {
+        if (max_c[d] - min_c[d] > max_c[dim] - min_c[dim]) dim = d;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    std::nth_element(points.begin() + lo, points.begin() + mid, points.begin() + hi,
+                     [dim](const BuildPoint& a, const BuildPoint& b) { return a.c[dim] < b.c[dim]; });
+    split_dim[mid] = static_cast<unsigned char>(dim);
+
+    if (hi - lo >= kParallelBuildThreshold) {
+        #pragma omp task shared(points, split_dim)
+        buildRange(points, split_dim, lo, mid, leaf_size);
+        #pragma omp task shared(points, split_dim)
+        buildRange(points, split_dim, mid + 1, hi, leaf_size);
+        #pragma omp taskwait
+    } else {
+        buildRange(points, split_dim, lo, mid, leaf_size);
+        buildRange(points, split_dim, mid + 1, hi, leaf_size);
+    }
+}
+
+} // namespace
+
+SpatialIndex::Query SpatialIndex::toUnitSphere(double lat, double lon) {
+    double phi = lat * M_PI / 180.0;
+    double lambda = lon * M_PI / 180.0;
+    return { std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi) };
+}
+
+double SpatialIndex::chordToKm(double squared_chord) {
+    // chord = 2 sin(theta / 2), i.e. the haversine term a = chord^2 / 4
+    double half_chord = std::min(1.0, std::sqrt(squared_chord) / 2.0);
+    return 2.0 * kEarthRadiusKm * std::asin(half_chord);
+}
+
+void SpatialIndex::clear() {
+    order_.clear();
+    xs_.clear();
+    ys_.clear();
+    zs_.clear();
+    split_dim_.clear();
+}
+
+void SpatialIndex::build(const std::vector<Node>& nodes) {
+    clear();
+    const size_t n = nodes.size();
+    if (n == 0) return;
+
+    std::vector<BuildPoint> points(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        Query p = toUnitSphere(nodes[i].coords.lat, nodes[i].coords.lon);
+        points[i] = { { p.x, p.y, p.z }, static_cast<int>(i) };
+    }
+
+    split_dim_.assign(n, 0);
+    #pragma omp parallel
+    #pragma omp single
+    buildRange(points, split_dim_, 0, n, kLeafSize);
+
+    order_.resize(n);
+    xs_.resize(n);
+    ys_.resize(n);
+    zs_.resize(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        order_[i] = points[i].index;
+        xs_[i] = points[i].c[0];
+        ys_[i] = points[i].c[1];
+        zs_[i] = points[i].c[2];
+    }
+    qDebug() << "SpatialIndex: Built k-d tree over" << n << "nodes.";
+}
+
+void SpatialIndex::leafDistances(const Query& q, size_t lo, size_t count, double* out) const {
+    const double* xs = xs_.data() + lo;
+    const double* ys = ys_.data() + lo;
+    const double* zs = zs_.data() + lo;
+    #pragma omp simd
+    for (size_t i = 0; i < count; ++i) {
+        double dx = xs[i] - q.x;
+        double dy = ys[i] - q.y;
+        double dz = zs[i] - q.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+void SpatialIndex::nearestInRange(const Query& q, size_t lo, size_t hi, size_t& best, double& best_d2) const {
+    if (hi - lo <= kLeafSize) {
+        double d2[kLeafSize];
+        leafDistances(q, lo, hi - lo, d2);
+        for (size_t i = 0; i < hi - lo; ++i) {
+            if (d2[i] < best_d2) {
+                best_d2 = d2[i];
+                best = lo + i;
+            }
+        }
+        return;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    double d2 = squaredChord(q, mid);
+    if (d2 < best_d2) {
+        best_d2 = d2;
+        best = mid;
+    }
+    // Descend into the query's side first; the other side can only help if the splitting
+    // plane is closer than the best point found so far
+    double delta = axisDelta(q, mid);
+    if (delta < 0) {
+        nearestInRange(q, lo, mid, best, best_d2);
+        if (delta * delta < best_d2) nearestInRange(q, mid + 1, hi, best, best_d2);
+    } else {
+        nearestInRange(q, mid + 1, hi, best, best_d2);
+        if (delta * delta < best_d2) nearestInRange(q, lo, mid, best, best_d2);
+    }
+}
+
+int SpatialIndex::nearest(double lat, double lon, double* distance_km) const {
+    if (order_.empty()) return -1;
+    Query q = toUnitSphere(lat, lon);
+    size_t best = 0;
+    double best_d2 = std::numeric_limits<double>::infinity();
+    nearestInRange(q, 0, order_.size(), best, best_d2);
+    if (distance_km) *distance_km = chordToKm(best_d2);
+    return order_[best];
+}
+
+void SpatialIndex::nearestBatch(const double* lats, const double* lons, size_t count,
+                                int* indices, double* distances_km) const {
+    if (order_.empty()) {
+        std::fill(indices, indices + count, -1);
+        std::fill(distances_km, distances_km + count, std::numeric_limits<double>::infinity());
+        return;
+    }
+    // Chunks keep neighboring (often consecutive GPS fix) queries on one thread, so they walk
+    // the same tree paths while those are still in cache
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (size_t i = 0; i < count; ++i) {
+        Query q = toUnitSphere(lats[i], lons[i]);
+        size_t best = 0;
+        double best_d2 = std::numeric_limits<double>::infinity();
+        nearestInRange(q, 0, order_.size(), best, best_d2);
+        indices[i] = order_[best];
+        distances_km[i] = chordToKm(best_d2);
+    }
+}
+
+void SpatialIndex::kNearestInRange(const Query& q, size_t lo, size_t hi, size_t k,
+                                   std::vector<std::pair<double, size_t>>& heap) const {
+    // 'heap' is a max-heap on squared chord holding the k best candidates so far
+    auto consider = [&](size_t i, double d2) {
+        if (heap.size() < k) {
+            heap.push_back({ d2, i });
+            std::push_heap(heap.begin(), heap.end());
+        } else if (d2 < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = { d2, i };
+            std::push_heap(heap.begin(), heap.end());
+        }
+    };
+
+    if (hi - lo <= kLeafSize) {
+        double d2[kLeafSize];
+        leafDistances(q, lo, hi - lo, d2);
+        for (size_t i = 0; i < hi - lo; ++i) consider(lo + i, d2[i]);
+        return;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    consider(mid, squaredChord(q, mid));
+    double delta = axisDelta(q, mid);
+    size_t near_lo = delta < 0 ? lo : mid + 1;
+    size_t near_hi = delta < 0 ? mid : hi;
+    size_t far_lo = delta < 0 ? mid + 1 : lo;
+    size_t far_hi = delta < 0 ? hi : mid;
+    kNearestInRange(q, near_lo, near_hi, k, heap);
+    if (heap.size() < k || delta * delta < heap.front().first) {
+        kNearestInRange(q, far_lo, far_hi, k, heap);
+    }
+}
+
+std::vector<std::pair<int, double>> SpatialIndex::kNearest(double lat, double lon, size_t k) const {
+    std::vector<std::pair<int, double>> result;
+    if (order_.empty() || k == 0) return result;
+
+    Query q = toUnitSphere(lat, lon);
+    std::vector<std::pair<double, size_t>> heap;
+    heap.reserve(std::min(k, order_.size()));
+    kNearestInRange(q, 0, order_.size(), k, heap);
+
+    std::sort_heap(heap.begin(), heap.end()); // Ascending by distance
+    result.reserve(heap.size());
+    for (const auto& entry : heap) {
+        result.emplace_back(order_[entry.second], chordToKm(entry.first));
+    }
+    return result;
+}
+
+void SpatialIndex::save(SnapshotWriter& writer) const {
+    writer.writeArray(order_);
+    writer.writeArray(xs_);
+    writer.writeArray(ys_);
+    writer.writeArray(zs_);
+    writer.writeArray(split_dim_);
+}
+
+bool SpatialIndex::load(SnapshotReader& reader, size_t node_count) {
+    clear();
+    reader.readArray(order_);
+    reader.readArray(xs_);
+    reader.readArray(ys_);
+    reader.readArray(zs_);
+    reader.readArray(split_dim_);
+    // The tree covers every node, so a shorter section would silently drop nodes from lookups
+    const size_t n = order_.size();
+    bool valid = reader.ok() && n == node_count && xs_.size() == n && ys_.size() == n && zs_.size() == n && split_dim_.size() == n;
+    for (size_t i = 0; valid && i < n; ++i) {
+        valid = order_[i] >= 0 && static_cast<size_t>(order_[i]) < node_count && split_dim_[i] < 3;
+    }
+    if (!valid) clear();
+    return valid;
+}
@@ -0,0 +1,79 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#include "data_types.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Static k-d tree over node coordinates for nearest-node lookups (map clicks, snapping).
+//
+// Points are mapped to the unit sphere (x, y, z). The chord length between two points there is a
+// monotonic function of their great-circle distance, so the nearest point by chord is exactly
+// the nearest by haversine, without any special cases at the antimeridian or the poles.
+//
+// The tree is implicit: points are stored in flat arrays permuted into tree order, the node of a
+// range [lo, hi) is its median position, and ranges of at most kLeafSize points are leaves that
+// are scanned linearly.
+class SpatialIndex {
+public:
+    // Builds the index over 'nodes'; results refer to positions (dense indices) in that vector
+    void build(const std::vector<Node>& nodes);
+    void clear();
+    size_t size() const { return order_.size(); }
+    bool empty() const { return order_.empty(); }
+
+    // Dense index of the closest node, -1 if the index is empty. Optionally returns its
+    // great-circle distance in kilometers.
+    int nearest(double lat, double lon, double* distance_km = nullptr) const;
+
+    // Up to k closest nodes as (dense index, distance in km), closest first
+    std::vector<std::pair<int, double>> kNearest(double lat, double lon, size_t k) const;
+
+    // nearest() for 'count' points at once, in parallel. Writes the dense index (-1 if the index
+    // is empty) and distance in km of each point's closest node to the output arrays.
+    void nearestBatch(const double* lats, const double* lons, size_t count,
+                      int* indices, double* distances_km) const;
+
+    // Graph snapshot sections; load() returns false (leaving the index empty) if the data is
+    // inconsistent or does not hold exactly 'node_count' nodes
+    void save(SnapshotWriter& writer) const;
+    bool load(SnapshotReader& reader, size_t node_count);
+
+private:
+    static constexpr size_t kLeafSize = 16; // Two to four SIMD passes of the leaf kernel
+
+    struct Query {
+        double x, y, z;
+    };
+
+    void nearestInRange(const Query& q, size_t lo, size_t hi, size_t& best, double& best_d2) const;
+    void kNearestInRange(const Query& q, size_t lo, size_t hi, size_t k,
+                         std::vector<std::pair<double, size_t>>& heap) const;
+    // Squared chords from q to the points at [lo, lo + count), count <= kLeafSize
+    void leafDistances(const Query& q, size_t lo, size_t count, double* out) const;
+    double squaredChord(const Query& q, size_t i) const {
+        double dx = xs_[i] - q.x, dy = ys_[i] - q.y, dz = zs_[i] - q.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+    double axisDelta(const Query& q, size_t i) const {
+        switch (split_dim_[i]) {
+            case 0: return q.x - xs_[i];
+            case 1: return q.y - ys_[i];
+            default: return q.z - zs_[i];
+        }
+    }
+    static Query toUnitSphere(double lat, double lon);
+    static double chordToKm(double squared_chord);
+
+    // All arrays are in tree order
+    std::vector<int> order_;                // Dense node index of each position
+    std::vector<double> xs_, ys_, zs_;      // Unit-sphere coordinates (SoA for the leaf scans)
+    std::vector<unsigned char> split_dim_;  // Split axis of the inner node at each median position
+};
+
+#endif // SPATIAL_INDEX_H